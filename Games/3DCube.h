@@ -4,10 +4,18 @@
  * @brief A 3D cube renderer for the menu system.
 */
 
+#include "../system/Governor.h"
+
 #define X_AXIS 0
 #define Y_AXIS 1
 #define Z_AXIS 2
 
+#define MAX_OBJECTS 3
+#define CUBE_VERTICES 8
+#define CUBE_EDGES 12
+#define CUBE_FACES 6
+#define RENORMALIZE_EVERY 16
+
 /**
  * A struct for handling 3D vertices
  * 
@@ -29,236 +37,426 @@ struct Vertex3D
 };
 
 /**
- * A struct for handling 2D vertices
- * 
- * @param x The x coordinate of the vertex
- * @param y The y coordinate of the vertex
+ * A projected vertex in screen coordinates
 */
-struct Vertex2D
+struct ScreenPoint
 {
-    float x, y = 0;
+    int16_t x, y;
+};
+
+const int8_t cubeVertices[CUBE_VERTICES][3] PROGMEM = {
+    {1, 1, 1}, {1, -1, 1}, {-1, -1, 1}, {-1, 1, 1},
+    {1, 1, -1}, {1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}};
+
+const uint8_t cubeEdges[CUBE_EDGES][2] PROGMEM = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0},
+    {4, 5}, {5, 6}, {6, 7}, {7, 4},
+    {4, 0}, {1, 5}, {2, 6}, {3, 7}};
+
+const uint8_t cubeFaces[CUBE_FACES][4] PROGMEM = {
+    {0, 1, 2, 3}, {4, 5, 6, 7}, {0, 1, 5, 4},
+    {3, 2, 6, 7}, {0, 3, 7, 4}, {1, 2, 6, 5}};
 
-    Vertex2D(){};
-    Vertex2D(float _x, float _y)
+/**
+ * A 3x3 rotation matrix
+*/
+struct Matrix3
+{
+    float m[3][3];
+
+    /**
+     * Get the identity matrix
+    */
+    static Matrix3 identity()
     {
-        x = _x;
-        y = _y;
+        Matrix3 r;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                r.m[i][j] = i == j ? 1 : 0;
+            }
+        }
+        return r;
+    }
+
+    /**
+     * Get a rotation around one of the axes
+     * 
+     * @param axis X_AXIS, Y_AXIS or Z_AXIS
+     * @param angle The angle to rotate by (radians)
+    */
+    static Matrix3 rotation(int axis, float angle)
+    {
+        Matrix3 r = identity();
+        float c = cos(angle);
+        float s = sin(angle);
+
+        // The two axes that turn
+        int a = axis == X_AXIS ? Y_AXIS : X_AXIS;
+        int b = axis == Z_AXIS ? Y_AXIS : Z_AXIS;
+
+        r.m[a][a] = c;
+        r.m[a][b] = s;
+        r.m[b][a] = -s;
+        r.m[b][b] = c;
+        return r;
+    }
+
+    Matrix3 operator*(const Matrix3 &o) const
+    {
+        Matrix3 r;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j];
+            }
+        }
+        return r;
+    }
+
+    /**
+     * Make the rows unit length and perpendicular again, to undo the float
+     * error that builds up from many small rotations.
+    */
+    void orthonormalize()
+    {
+        normalize(m[0]);
+
+        float d = m[0][0] * m[1][0] + m[0][1] * m[1][1] + m[0][2] * m[1][2];
+        for (int i = 0; i < 3; i++)
+        {
+            m[1][i] -= d * m[0][i];
+        }
+        normalize(m[1]);
+
+        m[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+        m[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+        m[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    }
+
+private:
+    static void normalize(float *v)
+    {
+        float length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (int i = 0; i < 3; i++)
+        {
+            v[i] /= length;
+        }
     }
 };
 
 /**
- * A simple struct for handling edges easily
+ * The camera the scene is seen through
  * 
- * The edges are stored completely in 2D and thereby do not need to be converted
+ * @param position Where the camera is, looking along the Z axis
+ * @param distance Focal length of the perspective projection
+ * @param scale Pixels per unit at the focal length
+*/
+struct Camera
+{
+    Vertex3D position = Vertex3D(0, 0, 0);
+    float distance = 5;
+    float scale = 10;
+};
+
+/**
+ * An object in the scene
  * 
- * @param p1 The first vertex of the edge
- * @param p2 The second vertex of the edge
+ * The orientation is kept as a matrix and each rotation is multiplied into
+ * it, instead of rotating the vertices themselves. The vertices are always
+ * transformed from the original mesh, so they cannot slowly deform.
 */
-struct Edge
+struct SceneObject
 {
-    Vertex2D *p1;
-    Vertex2D *p2;
+    Matrix3 orientation;
+    Vertex3D position;
+    float size;
+
+    Vertex3D spin;
+    uint8_t rotations;
 
-    Edge(){};
-    Edge(Vertex2D *_p1, Vertex2D *_p2)
+    ScreenPoint screen[CUBE_VERTICES];
+    float depth;
+
+    /**
+     * Rotate the object around a world axis
+     * 
+     * @param axis X_AXIS, Y_AXIS or Z_AXIS
+     * @param angle The angle to rotate by (radians)
+    */
+    void rotate(int axis, float angle)
     {
-        p1 = _p1;
-        p2 = _p2;
+        orientation = Matrix3::rotation(axis, angle) * orientation;
+
+        if (++rotations >= RENORMALIZE_EVERY)
+        {
+            orientation.orthonormalize();
+            rotations = 0;
+        }
     }
 };
 
 /**
  * @brief A 3D cube renderer using the U8GLIB library
  * 
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen
+ * Draws a small scene of cubes. The first cube is turned with the buttons,
+ * the others spin by themselves. Cubes are drawn back to front and each
+ * cube in front blanks its faces first, so it hides the ones behind it.
+ * 
+ * At medium quality the faces are not blanked, and at low quality only the
+ * first cube is transformed and drawn.
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object for drawing to the screen
 */
+template <int WIDTH, int HEIGHT>
 class Cube
 {
 private:
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
 
-    Vertex3D v[8];
-    Vertex2D v2D[8];
+    SceneObject objects[MAX_OBJECTS];
+    uint8_t order[MAX_OBJECTS];
+    int count = 0;
 
-    Edge e[12];
+    Camera camera;
 
-    int fl = 5;
-    int sc = 10;
+    uint8_t quality = QUALITY_HIGH;
 
-public:
-    Cube(){};
-    Cube(U8GLIB_SSD1306_128X64 *_u8g)
+    /**
+     * Get the number of objects that are transformed and drawn at the
+     * current quality. The first object is always one of them.
+    */
+    int visible()
     {
-        u8g = _u8g;
-
-        v[0] = Vertex3D(1, 1, 1);
-        v[1] = Vertex3D(1, -1, 1);
-        v[2] = Vertex3D(-1, -1, 1);
-        v[3] = Vertex3D(-1, 1, 1);
-        v[4] = Vertex3D(1, 1, -1);
-        v[5] = Vertex3D(1, -1, -1);
-        v[6] = Vertex3D(-1, -1, -1);
-        v[7] = Vertex3D(-1, 1, -1);
+        return quality == QUALITY_LOW ? 1 : count;
     }
 
-
     /**
-     * Initialize the cube
+     * Add a cube to the scene
+     * 
+     * @param position The center of the cube
+     * @param size Half the length of a side
+     * @param spin Rotation per update around each axis (radians)
     */
-    void init()
+    void add(Vertex3D position, float size, Vertex3D spin)
     {
-        v[0] = Vertex3D(1, 1, 1);
-        v[1] = Vertex3D(1, -1, 1);
-        v[2] = Vertex3D(-1, -1, 1);
-        v[3] = Vertex3D(-1, 1, 1);
-        v[4] = Vertex3D(1, 1, -1);
-        v[5] = Vertex3D(1, -1, -1);
-        v[6] = Vertex3D(-1, -1, -1);
-        v[7] = Vertex3D(-1, 1, -1);
-
-        for (int i = 0; i < 8; i++)
+        if (count >= MAX_OBJECTS)
         {
-            v2D[i] = projectPoint(v[i]);
+            return;
         }
 
-        e[0] = Edge(&v2D[0], &v2D[1]);
-        e[1] = Edge(&v2D[1], &v2D[2]);
-        e[2] = Edge(&v2D[2], &v2D[3]);
-        e[3] = Edge(&v2D[3], &v2D[0]);
-        e[4] = Edge(&v2D[4], &v2D[5]);
-        e[5] = Edge(&v2D[5], &v2D[6]);
-        e[6] = Edge(&v2D[6], &v2D[7]);
-        e[7] = Edge(&v2D[7], &v2D[4]);
-        e[8] = Edge(&v2D[4], &v2D[0]);
-        e[9] = Edge(&v2D[1], &v2D[5]);
-        e[10] = Edge(&v2D[2], &v2D[6]);
-        e[11] = Edge(&v2D[3], &v2D[7]);
-
-        sc = 10;
+        SceneObject &o = objects[count++];
+        o.orientation = Matrix3::identity();
+        o.position = position;
+        o.size = size;
+        o.spin = spin;
+        o.rotations = 0;
     }
 
     /**
-     * Draw the cube to the screen
+     * Transform and project the vertices of an object. The rotation, size
+     * and camera are combined into one transform first, so each vertex only
+     * takes one matrix multiply and one divide.
     */
-    void draw()
+    void project(SceneObject &o)
     {
-        for (int i = 0; i < 8; i++)
+        float t[3] = {
+            o.position.x - camera.position.x,
+            o.position.y - camera.position.y,
+            o.position.z - camera.position.z + camera.distance};
+        float k = camera.distance * camera.scale;
+
+        float r[3][3];
+        for (int i = 0; i < 3; i++)
         {
-            // u8g->drawCircle((v2D[i].x * 10) + 64, (v2D[i].y * 10) + 32, 1);
+            for (int j = 0; j < 3; j++)
+            {
+                r[i][j] = o.orientation.m[i][j] * o.size;
+            }
         }
 
-        for (int i = 0; i < 12; i++)
+        o.depth = t[2];
+
+        for (int i = 0; i < CUBE_VERTICES; i++)
         {
-            u8g->drawLine((e[i].p1->x * sc) + 64,
-                          (e[i].p1->y * sc) + 32,
-                          (e[i].p2->x * sc) + 64,
-                          (e[i].p2->y * sc) + 32);
+            float v[3];
+            for (int j = 0; j < 3; j++)
+            {
+                v[j] = (int8_t)pgm_read_byte(&cubeVertices[i][j]);
+            }
+
+            float x = r[0][0] * v[0] + r[0][1] * v[1] + r[0][2] * v[2] + t[0];
+            float y = r[1][0] * v[0] + r[1][1] * v[1] + r[1][2] * v[2] + t[1];
+            float z = r[2][0] * v[0] + r[2][1] * v[1] + r[2][2] * v[2] + t[2];
+
+            if (z < 0.1)
+            {
+                z = 0.1;
+            }
+
+            o.screen[i].x = k * x / z + WIDTH / 2;
+            o.screen[i].y = k * y / z + HEIGHT / 2;
         }
     }
 
     /**
-     * Rotating the cube from user inputs.
+     * Sort the objects from the farthest to the nearest.
     */
-    void update()
+    void sortByDepth()
     {
-        if (digitalRead(2))
-        {
-            rotateY(PI / 16);
-        }
-        else if (digitalRead(3))
+        for (int i = 1; i < count; i++)
         {
-            rotateY(PI / -16);
+            uint8_t current = order[i];
+            int j = i - 1;
+            while (j >= 0 && objects[order[j]].depth < objects[current].depth)
+            {
+                order[j + 1] = order[j];
+                j--;
+            }
+            order[j + 1] = current;
         }
+    }
 
-        if (digitalRead(4))
-        {
-            rotateZ(PI / 16);
-        }
-        else if (digitalRead(5))
+    /**
+     * Fill the faces of an object with the background color.
+    */
+    void blank(const SceneObject &o)
+    {
+        u8g->setDefaultBackgroundColor();
+        for (int i = 0; i < CUBE_FACES; i++)
         {
-            rotateZ(PI / -16);
+            const ScreenPoint &a = o.screen[pgm_read_byte(&cubeFaces[i][0])];
+            const ScreenPoint &b = o.screen[pgm_read_byte(&cubeFaces[i][1])];
+            const ScreenPoint &c = o.screen[pgm_read_byte(&cubeFaces[i][2])];
+            const ScreenPoint &d = o.screen[pgm_read_byte(&cubeFaces[i][3])];
+            u8g->drawTriangle(a.x, a.y, b.x, b.y, c.x, c.y);
+            u8g->drawTriangle(a.x, a.y, c.x, c.y, d.x, d.y);
         }
+        u8g->setDefaultForegroundColor();
+    }
+
+public:
+    Cube(){};
+    Cube(U8GLIB *_u8g)
+    {
+        u8g = _u8g;
+    }
+
+    /**
+     * Initialize the scene
+    */
+    void init()
+    {
+        count = 0;
+        add(Vertex3D(0, 0, 0), 1, Vertex3D(0, 0, 0));
+        add(Vertex3D(-2, 0.5, 2), 0.6, Vertex3D(0.05, 0.08, 0));
+        add(Vertex3D(2, -0.5, -1.5), 0.4, Vertex3D(0, -0.06, 0.1));
 
-        for (int i = 0; i < 8; i++)
+        for (int i = 0; i < count; i++)
         {
-            v2D[i] = projectPoint(v[i]);
+            order[i] = i;
+            project(objects[i]);
         }
+        sortByDepth();
     }
 
     /**
-     * Project a 3D point to a 2D point using planar perspective projection
+     * Get the camera, to move it or change the projection
      * 
-     * @param p The 3D point to project
+     * @return The camera of the scene
+    */
+    Camera &getCamera() { return camera; }
+
+    /**
+     * Set the quality level
      * 
-     * @return The 2D point
+     * @param _quality QUALITY_LOW to QUALITY_HIGH
     */
-    Vertex2D projectPoint(Vertex3D p)
+    void setQuality(uint8_t _quality)
     {
-        Vertex2D proj;
-        proj.x = fl * p.x / (fl + p.z);
-        proj.y = fl * p.y / (fl + p.z);
+        bool wasLow = quality == QUALITY_LOW;
+        quality = _quality;
 
-        return proj;
+        // The hidden cubes have not been projected while the quality was low
+        if (wasLow && quality != QUALITY_LOW)
+        {
+            for (int i = 1; i < count; i++)
+            {
+                project(objects[i]);
+            }
+            sortByDepth();
+        }
     }
 
-    
     /**
-     * Rotate the cube around the Z axis
-     *
-     * @param angle The angle to rotate the cube by (radians)
+     * Draw the scene to the screen
     */
-    void rotateY(double angle)
+    void draw()
     {
-
-        const tmm::Scalar rScalar[3][3] = {
-            {cos(angle), 0, -sin(angle)},
-            {0, 1, 0},
-            {sin(angle), 0, cos(angle)}};
-
-        tmm::SquareMatrix<3> rMatrix(rScalar);
-
-        for (int i = 0; i < 8; i++)
+        for (int n = 0; n < count; n++)
         {
-            const tmm::Scalar vScalar[1][3] = {
-                {v[i].x, v[i].y, v[i].z}};
-
-            tmm::Matrix<1, 3> vMatrix(vScalar);
-
-            tmm::Matrix<1, 3> newMatrix = vMatrix * rMatrix;
-
-            v[i].x = newMatrix.data[0][0];
-            v[i].y = newMatrix.data[0][1];
-            v[i].z = newMatrix.data[0][2];
+            if (order[n] >= visible())
+            {
+                continue;
+            }
+            const SceneObject &o = objects[order[n]];
+
+            // Nothing is behind the farthest object, so it needs no blanking
+            if (n > 0 && quality == QUALITY_HIGH)
+            {
+                blank(o);
+            }
+
+            for (int i = 0; i < CUBE_EDGES; i++)
+            {
+                const ScreenPoint &a = o.screen[pgm_read_byte(&cubeEdges[i][0])];
+                const ScreenPoint &b = o.screen[pgm_read_byte(&cubeEdges[i][1])];
+                u8g->drawLine(a.x, a.y, b.x, b.y);
+            }
         }
     }
 
     /**
-     * Rotate the cube around the Z axis
-     * 
-     * @param angle The angle to rotate the cube by (radians)
+     * Rotating the cube from user inputs.
     */
-    void rotateZ(double angle)
+    void update()
     {
+        SceneObject &player = objects[0];
 
-        const tmm::Scalar rScalar[3][3] = {
-            {cos(angle), -sin(angle), 0},
-            {sin(angle), cos(angle), 0},
-            {0, 0, 1}};
-
-        tmm::SquareMatrix<3> rMatrix(rScalar);
-
-        for (int i = 0; i < 8; i++)
+        if (digitalRead(2))
+        {
+            player.rotate(Y_AXIS, PI / 16);
+        }
+        else if (digitalRead(3))
         {
-            const tmm::Scalar vScalar[1][3] = {
-                {v[i].x, v[i].y, v[i].z}};
+            player.rotate(Y_AXIS, PI / -16);
+        }
 
-            tmm::Matrix<1, 3> vMatrix(vScalar);
+        if (digitalRead(4))
+        {
+            player.rotate(Z_AXIS, PI / 16);
+        }
+        else if (digitalRead(5))
+        {
+            player.rotate(Z_AXIS, PI / -16);
+        }
 
-            tmm::Matrix<1, 3> newMatrix = vMatrix * rMatrix;
+        for (int i = 1; i < visible(); i++)
+        {
+            SceneObject &o = objects[i];
+            o.rotate(X_AXIS, o.spin.x);
+            o.rotate(Y_AXIS, o.spin.y);
+            o.rotate(Z_AXIS, o.spin.z);
+        }
 
-            v[i].x = newMatrix.data[0][0];
-            v[i].y = newMatrix.data[0][1];
-            v[i].z = newMatrix.data[0][2];
+        for (int i = 0; i < visible(); i++)
+        {
+            project(objects[i]);
         }
+        sortByDepth();
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,97 @@
+/**
+ * @file Digits.h
+ * 
+ * @brief Pre-rendered digits for drawing numbers without the font engine.
+*/
+
+#ifndef DIGITS_H
+#define DIGITS_H
+
+#define DIGIT_WIDTH 5
+#define DIGIT_HEIGHT 7
+#define DIGIT_SPACING 6
+#define MAX_DIGITS 5
+
+/**
+ * 5x7 bitmaps for the digits 0-9, one byte per row, left aligned.
+*/
+const uint8_t digitGlyphs[10][DIGIT_HEIGHT] PROGMEM = {
+    {0x70, 0x88, 0x98, 0xA8, 0xC8, 0x88, 0x70},
+    {0x20, 0x60, 0x20, 0x20, 0x20, 0x20, 0x70},
+    {0x70, 0x88, 0x08, 0x10, 0x20, 0x40, 0xF8},
+    {0xF8, 0x10, 0x20, 0x10, 0x08, 0x88, 0x70},
+    {0x10, 0x30, 0x50, 0x90, 0xF8, 0x10, 0x10},
+    {0xF8, 0x80, 0xF0, 0x08, 0x08, 0x88, 0x70},
+    {0x30, 0x40, 0x80, 0xF0, 0x88, 0x88, 0x70},
+    {0xF8, 0x08, 0x10, 0x20, 0x40, 0x40, 0x40},
+    {0x70, 0x88, 0x88, 0x70, 0x88, 0x88, 0x70},
+    {0x70, 0x88, 0x88, 0x78, 0x08, 0x10, 0x60}};
+
+/**
+ * A number drawn centered around a point using the digit bitmaps.
+ * 
+ * The digits and their position are only worked out again when the value
+ * changes, so drawing is just one bitmap copy per digit.
+ * 
+ * @param u8g U8GLIB object for drawing to the screen
+ * @param center X position to center the number around
+ * @param y Y position of the top of the number
+*/
+class Digits
+{
+private:
+    U8GLIB *u8g;
+
+    int value = -1;
+    uint8_t digits[MAX_DIGITS];
+    uint8_t count = 0;
+
+    int center;
+    int x, y;
+
+public:
+    Digits(){};
+    Digits(U8GLIB *_u8g, int _center, int _y)
+    {
+        u8g = _u8g;
+        center = _center;
+        y = _y;
+    }
+
+    /**
+     * Set the number to draw
+     * 
+     * @param _value The number, must not be negative
+    */
+    void set(int _value)
+    {
+        if (_value == value)
+        {
+            return;
+        }
+        value = _value;
+
+        unsigned int rest = value;
+        count = 0;
+        do
+        {
+            digits[count++] = rest % 10;
+            rest /= 10;
+        } while (rest > 0 && count < MAX_DIGITS);
+
+        x = center - (count * DIGIT_SPACING - 1) / 2;
+    }
+
+    /**
+     * Draw the number to the screen.
+    */
+    void draw()
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            u8g->drawBitmapP(x + i * DIGIT_SPACING, y, 1, DIGIT_HEIGHT, digitGlyphs[digits[count - 1 - i]]);
+        }
+    }
+};
+
+#endif
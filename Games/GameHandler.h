@@ -10,34 +10,50 @@
 #include "Snake.h"
 #include "Pong.h"
 #include "3DCube.h"
+#include "PongLink.h"
+#include "../system/Memory.h"
 
 #define SNAKE_ID 0
+#define MEMORY_ID 3
+#define LINK_PONG_ID 4
+
+#define GAME_COUNT 3
+
+const char *const gameNames[GAME_COUNT] = {"Snake", "Pong", "Cube"};
 
 /**
  * Game handler for handling the games
  * 
- * @param U8GLIB_SSD1306_128X64 The display
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g The display
  * @param game The id of the selected game
 */
+template <int WIDTH, int HEIGHT>
 class GameHandler
 {
 private:
+    static const int gameSizes[GAME_COUNT];
+
     int game = 0;
-    Snake snake;
-    Pong pong;
-    Cube cube;
-    U8GLIB_SSD1306_128X64 *u8g;
+    Snake<WIDTH, HEIGHT> snake;
+    Pong<WIDTH, HEIGHT> pong;
+    Cube<WIDTH, HEIGHT> cube;
+    MemoryScreen<WIDTH, HEIGHT> memory;
+    PongLink<WIDTH, HEIGHT> link;
+    U8GLIB *u8g;
 
 public:
     GameHandler(){};
 
-    GameHandler(U8GLIB_SSD1306_128X64 *_u8g, int _game)
+    GameHandler(U8GLIB *_u8g, int _game)
+        : game(_game),
+          snake(_u8g),
+          pong(_u8g),
+          cube(_u8g),
+          memory(_u8g, gameNames, gameSizes, GAME_COUNT),
+          u8g(_u8g)
     {
-        u8g = _u8g;
-        game = _game;
-        snake = Snake(u8g);
-        pong = Pong(u8g);
-        cube = Cube(u8g);
     }
 
     /**
@@ -45,6 +61,9 @@ public:
     */
     void init(void)
     {
+        scheduler.clear();
+        particles.clear();
+
         switch (game)
         {
         case 0:
@@ -56,6 +75,25 @@ public:
         case 2:
             cube.init();
             break;
+        case MEMORY_ID:
+            memory.init();
+            break;
+        case LINK_PONG_ID:
+            link.begin(&pong, &Serial, u8g);
+            break;
+        }
+    }
+
+    /**
+     * Let go of what the game holds when leaving it
+    */
+    void end(void)
+    {
+        switch (game)
+        {
+        case LINK_PONG_ID:
+            link.end();
+            break;
         }
     }
 
@@ -75,11 +113,21 @@ public:
         case 2:
             cube.draw();
             break;
+        case MEMORY_ID:
+            memory.draw();
+            break;
+        case LINK_PONG_ID:
+            pong.draw();
+            link.draw();
+            break;
         }
+
+        particles.draw(u8g);
     }
 
     /**
-     * Update the game
+     * Update the game, then give each task the game has handed to the
+     * scheduler one slice.
     */
     void update(void)
     {
@@ -94,9 +142,74 @@ public:
         case 2:
             cube.update();
             break;
+        case MEMORY_ID:
+            memory.update();
+            break;
+        case LINK_PONG_ID:
+            link.update();
+            break;
+        }
+
+        particles.update();
+        scheduler.run();
+    }
+
+    /**
+     * Set the quality the game runs at. The particle limit applies to every
+     * game; the cube also drops face blanking and the spinning cubes.
+     * 
+     * @param level QUALITY_LOW to QUALITY_HIGH
+    */
+    void setQuality(uint8_t level)
+    {
+        particles.setLimit(PARTICLE_COUNT >> (QUALITY_HIGH - level));
+
+        switch (game)
+        {
+        case 2:
+            cube.setQuality(level);
+            break;
         }
     }
 
+    /**
+     * Let the snake play itself
+     * 
+     * @param enabled true to turn the autopilot on
+    */
+    void setAutopilot(bool enabled)
+    {
+        snake.setAutopilot(enabled);
+    }
+
+#ifdef BENCHMARK
+    /**
+     * Run the game benchmarks and print the results as log text.
+    */
+    void benchmark(void)
+    {
+        snake.benchmark(500);
+    }
+#endif
+
+    /**
+     * Get the score of the current game
+     * 
+     * @return The score, or 0 if the game has none
+    */
+    int getScore(void)
+    {
+        switch (game)
+        {
+        case 0:
+            return snake.getScore();
+        case 1:
+        case LINK_PONG_ID:
+            return pong.getScore();
+        }
+        return 0;
+    }
+
     /**
      * Set the game
      * 
@@ -108,4 +221,10 @@ public:
     }
 };
 
+template <int WIDTH, int HEIGHT>
+const int GameHandler<WIDTH, HEIGHT>::gameSizes[GAME_COUNT] = {
+    sizeof(Snake<WIDTH, HEIGHT>),
+    sizeof(Pong<WIDTH, HEIGHT>),
+    sizeof(Cube<WIDTH, HEIGHT>)};
+
 #endif
\ No newline at end of file
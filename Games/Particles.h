@@ -0,0 +1,257 @@
+/**
+ * @file Particles.h
+ * 
+ * @brief Small particle effects for the games.
+ * 
+ * All particles live in one fixed pool, so there is no heap allocation and
+ * the work per frame is bounded by PARTICLE_COUNT. Free particles are linked
+ * through their own next field, which makes spawning and freeing O(1).
+ * Positions are 8.8 fixed point and velocities are in 1/16 pixels per tick.
+*/
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "../system/Log.h"
+
+#define PARTICLE_COUNT 16
+#define PARTICLE_NONE 0xFF
+#define PARTICLE_LIFE 8
+#define PARTICLE_GRAVITY 2
+
+/**
+ * A single particle
+*/
+struct Particle
+{
+    int16_t x, y;
+    int8_t vx, vy;
+    uint8_t life;
+    uint8_t next;
+};
+
+/**
+ * Pool of particles with a free list
+*/
+class Particles
+{
+private:
+    Particle pool[PARTICLE_COUNT];
+    uint8_t freeList;
+    uint8_t active;
+    uint8_t limit = PARTICLE_COUNT;
+
+    uint8_t seed = 1;
+
+    /**
+     * A cheap 8 bit random number for spreading particles, so bursts do not
+     * cost a call to random() per particle.
+    */
+    int8_t jitter()
+    {
+        seed = seed * 109 + 89;
+        return (int8_t)seed;
+    }
+
+    /**
+     * Return a particle to the free list.
+    */
+    void release(uint8_t i)
+    {
+        pool[i].life = 0;
+        pool[i].next = freeList;
+        freeList = i;
+        active--;
+    }
+
+public:
+    Particles()
+    {
+        clear();
+    }
+
+    /**
+     * Remove all particles.
+    */
+    void clear()
+    {
+        for (uint8_t i = 0; i < PARTICLE_COUNT; i++)
+        {
+            pool[i].life = 0;
+            pool[i].next = i + 1 < PARTICLE_COUNT ? i + 1 : PARTICLE_NONE;
+        }
+        freeList = 0;
+        active = 0;
+    }
+
+    /**
+     * Set how many particles can be alive at once. Lowering it does not kill
+     * particles that are already flying.
+     * 
+     * @param _limit The number of particles, at most PARTICLE_COUNT
+    */
+    void setLimit(uint8_t _limit)
+    {
+        limit = _limit < PARTICLE_COUNT ? _limit : PARTICLE_COUNT;
+    }
+
+    /**
+     * Spawn one particle. Does nothing if the pool is full.
+     * 
+     * @param x X position in pixels
+     * @param y Y position in pixels
+     * @param vx X velocity in 1/16 pixels per tick
+     * @param vy Y velocity in 1/16 pixels per tick
+     * @return false if the pool was full or at its limit
+    */
+    bool spawn(int x, int y, int8_t vx, int8_t vy)
+    {
+        if (freeList == PARTICLE_NONE || active >= limit)
+        {
+            return false;
+        }
+
+        uint8_t i = freeList;
+        freeList = pool[i].next;
+        active++;
+
+        pool[i].x = x << 8;
+        pool[i].y = y << 8;
+        pool[i].vx = vx;
+        pool[i].vy = vy;
+        pool[i].life = PARTICLE_LIFE;
+        return true;
+    }
+
+    /**
+     * Spawn particles flying out in random directions from a point.
+     * 
+     * @param x X position in pixels
+     * @param y Y position in pixels
+     * @param count The number of particles
+    */
+    void burst(int x, int y, uint8_t count)
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (!spawn(x, y, jitter() / 4, jitter() / 4))
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Move all particles one tick and free the ones that have died.
+    */
+    void update()
+    {
+        if (active == 0)
+        {
+            return;
+        }
+
+        for (uint8_t i = 0; i < PARTICLE_COUNT; i++)
+        {
+            Particle &p = pool[i];
+            if (p.life == 0)
+            {
+                continue;
+            }
+
+            if (--p.life == 0)
+            {
+                release(i);
+                continue;
+            }
+
+            p.x += p.vx << 4;
+            p.y += p.vy << 4;
+            if (p.vy < 127 - PARTICLE_GRAVITY)
+            {
+                p.vy += PARTICLE_GRAVITY;
+            }
+        }
+    }
+
+    /**
+     * Draw the particles that fall inside the current page.
+     * 
+     * @param u8g U8GLIB object for drawing to the screen
+    */
+    void draw(U8GLIB *u8g)
+    {
+        if (active == 0)
+        {
+            return;
+        }
+
+        u8g_t *g = u8g->getU8g();
+        int top = g->current_page.y0;
+        int bottom = g->current_page.y1;
+
+        for (uint8_t i = 0; i < PARTICLE_COUNT; i++)
+        {
+            Particle &p = pool[i];
+            if (p.life == 0)
+            {
+                continue;
+            }
+
+            int y = p.y >> 8;
+            if (y < top || y > bottom)
+            {
+                continue;
+            }
+
+            int x = p.x >> 8;
+            if (x >= 0 && x < g->width)
+            {
+                u8g->drawPixel(x, y);
+            }
+        }
+    }
+
+    /**
+     * Get the number of live particles
+     * 
+     * @return The number of particles in use
+    */
+    uint8_t count() { return active; }
+};
+
+Particles particles;
+
+#ifdef BENCHMARK
+/**
+ * Time the worst case of a full pool, printed as log text.
+ * 
+ * @param u8g U8GLIB object for drawing to the screen
+*/
+void benchmarkParticles(U8GLIB *u8g)
+{
+    particles.clear();
+    particles.burst(64, 32, PARTICLE_COUNT);
+
+    unsigned long start = micros();
+    particles.update();
+    unsigned long update = micros() - start;
+
+    start = micros();
+    u8g->firstPage();
+    do
+    {
+        particles.draw(u8g);
+    } while (u8g->nextPage());
+    unsigned long frame = micros() - start;
+
+    particles.clear();
+
+    logText.print(F("Particles update: "));
+    logText.println(update);
+    logText.print(F("Particles frame: "));
+    logText.println(frame);
+}
+#endif
+
+#endif
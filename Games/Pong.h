@@ -4,14 +4,40 @@
  * @brief A pong game for the menu system.
 */
 
+#include "Digits.h"
+#include "Particles.h"
+#include "../system/Random.h"
+
+#define PADDLE_UP 1
+#define PADDLE_DOWN 2
+
+/**
+ * Fold a block of memory into a running checksum.
+ * 
+ * @param hash The checksum so far
+ * @param data The bytes to add
+ * @param length The number of bytes
+ * @return The new checksum
+*/
+uint8_t foldChecksum(uint8_t hash, const void *data, uint8_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        hash = (hash << 1 | hash >> 7) ^ bytes[i];
+    }
+    return hash;
+}
 
 /**
  * Paddle class for the pong game
  * 
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object for drawing to the screen
  * @param x X position of the paddle
  * @param y Y position of the paddle
 */
+template <int HEIGHT>
 class Paddle
 {
 private:
@@ -21,13 +47,13 @@ private:
 
     int speed = 4;
 
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
 
 public:
     int score = 0;
 
     Paddle(){};
-    Paddle(U8GLIB_SSD1306_128X64 *_u8g, int _x, int _y)
+    Paddle(U8GLIB *_u8g, int _x, int _y)
     {
         u8g = _u8g;
         x = _x;
@@ -69,43 +95,64 @@ public:
             y = 0;
             return;
         }
-        if (y + direction * speed >= 48) {
-            y = 48;
+        if (y + direction * speed >= HEIGHT - h) {
+            y = HEIGHT - h;
             return;
         }
         y += direction * speed;
     }
+
+    /**
+     * Get the Y position of the paddle
+     * 
+     * @return int Y position of the paddle
+    */
+    int getY() { return y; }
 };
 
 /**
  * Ball class for the pong game
  * 
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object for drawing to the screen
  * @param p1 Paddle object for player 1
  * @param p2 Paddle object for player 2
 */
+template <int WIDTH, int HEIGHT>
 class Ball
 {
 private:
-    float x = 64, y = 32;
+    float x = WIDTH / 2, y = HEIGHT / 2;
     int speed = 5;
     double angle = PI / 6;
 
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
 
-    Paddle *p1;
-    Paddle *p2;
+    Paddle<HEIGHT> *p1;
+    Paddle<HEIGHT> *p2;
 
     bool gameOver = false;
 
+    Random rng;
+
 public:
     Ball(){};
-    Ball(U8GLIB_SSD1306_128X64 *_u8g, Paddle *_p1, Paddle *_p2)
+    Ball(U8GLIB *_u8g, Paddle<HEIGHT> *_p1, Paddle<HEIGHT> *_p2)
     {
         u8g = _u8g;
         p1 = _p1;
         p2 = _p2;
-        randomSeed(analogRead(A2));
+    }
+
+    /**
+     * Set the seed of the ball's random stream.
+     * 
+     * @param seed The seed
+    */
+    void seed(uint32_t seed)
+    {
+        rng.seed(seed);
     }
 
     /**
@@ -123,7 +170,7 @@ public:
     {
 
         // Bounce on walls
-        if (y >= 62 || y <= 2)
+        if (y >= HEIGHT - 2 || y <= 2)
         {
             angle = -angle;
         }
@@ -131,22 +178,26 @@ public:
         // Bounce on paddles
         if (p1->collided(x, y) || p2->collided(x, y))
         {
+            // The right paddle is hit at up to WIDTH, which does not fit the
+            // 8.8 position of a particle
+            particles.burst(x < WIDTH ? x : WIDTH - 1, y, 4);
+
             angle += PI;
             angle = -angle;
             
 
             // Change angle by a small amount
-            int dir = random(2) == 0 ? -1 : 1;
-            int _a = random(8, 16);
+            int dir = rng.below(2) == 0 ? -1 : 1;
+            int _a = rng.between(8, 16);
             float angleOffset = PI / (dir * _a);
             angle += angleOffset;
 
             // Increase speed
-            speed += (random(2) == 0 ? 1 : 1);
+            speed += 1;
         }
 
         // If ball is out of bounds
-        if (x > 128 || x < 0)
+        if (x > WIDTH || x < 0)
         {
             gameOver = true;
         }
@@ -175,10 +226,10 @@ public:
         speed = 5;
 
         gameOver = false;
-        x = 64;
-        y = 32;
-        int dir = random(2) == 0 ? -1 : 1;
-        int _a = random(4, 11);
+        x = WIDTH / 2;
+        y = HEIGHT / 2;
+        int dir = rng.below(2) == 0 ? -1 : 1;
+        int _a = rng.between(4, 11);
         
         angle = PI / (dir * _a) + (side == -1 ? PI : 0);
     }
@@ -192,26 +243,46 @@ public:
     {
         return (int)x;
     }
+
+    /**
+     * Add the ball's state to a checksum.
+     * 
+     * @param hash The checksum so far
+     * @return The new checksum
+    */
+    uint8_t checksum(uint8_t hash)
+    {
+        hash = foldChecksum(hash, &x, sizeof(x));
+        hash = foldChecksum(hash, &y, sizeof(y));
+        hash = foldChecksum(hash, &angle, sizeof(angle));
+        return foldChecksum(hash, &speed, sizeof(speed));
+    }
 };
 
 /**
  * Pong game for being used with the simple menu system.
  * 
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen.
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object for drawing to the screen.
 */
+template <int WIDTH, int HEIGHT>
 class Pong
 {
 private:
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
 
-    Paddle player1;
-    Paddle player2;
+    Paddle<HEIGHT> player1;
+    Paddle<HEIGHT> player2;
 
-    Ball ball;
+    Ball<WIDTH, HEIGHT> ball;
+
+    Digits score1;
+    Digits score2;
 
 public:
     Pong(){};
-    Pong(U8GLIB_SSD1306_128X64 *_u8g)
+    Pong(U8GLIB *_u8g)
     {
         u8g = _u8g;
     }
@@ -221,29 +292,49 @@ public:
     */
     void init()
     {
-        player1 = Paddle(u8g, 2, 0);
-        player2 = Paddle(u8g, 122, 0);
+        player1 = Paddle<HEIGHT>(u8g, 2, 0);
+        player2 = Paddle<HEIGHT>(u8g, WIDTH - 6, 0);
+
 
+        ball = Ball<WIDTH, HEIGHT>(u8g, &player1, &player2);
+        ball.seed(randomSource.next());
 
-        ball = Ball(u8g, &player1, &player2);
+        score1 = Digits(u8g, WIDTH / 2 - 9, 2);
+        score2 = Digits(u8g, WIDTH / 2 + 9, 2);
+        score1.set(player1.score);
+        score2.set(player2.score);
     };
 
+    /**
+     * Set the seed of the game, so two games can be made to play the same.
+     * 
+     * @param seed The seed
+    */
+    void seed(uint32_t seed)
+    {
+        ball.seed(seed);
+    }
+
+    /**
+     * Get the score, which is the highest score of the two players.
+     * 
+     * @return The highest score
+    */
+    int getScore()
+    {
+        return player1.score > player2.score ? player1.score : player2.score;
+    }
+
     /**
      * Draw the game.
     */
     void draw()
     {
 
-        u8g->drawLine(64, 0, 64, 64);
+        u8g->drawLine(WIDTH / 2, 0, WIDTH / 2, HEIGHT);
 
-        char score[16];
-        itoa(player1.score, score, 10);
-        int d = (110 - u8g->getStrWidth(score)) / 2;
-        u8g->drawStr(d, 2, score);
-
-        itoa(player2.score, score, 10);
-        d = (146 - u8g->getStrWidth(score)) / 2;
-        u8g->drawStr(d, 2, score);
+        score1.draw();
+        score2.draw();
 
         player1.draw();
         player2.draw();
@@ -251,31 +342,78 @@ public:
     }
 
     /**
-     * Update the game.
+     * Read a paddle's buttons.
+     * 
+     * @param upPin The pin of the up button
+     * @param downPin The pin of the down button
+     * @return PADDLE_UP, PADDLE_DOWN or 0
+    */
+    static uint8_t readInput(int upPin, int downPin)
+    {
+        if (digitalRead(upPin))
+        {
+            return PADDLE_UP;
+        }
+        if (digitalRead(downPin))
+        {
+            return PADDLE_DOWN;
+        }
+        return 0;
+    }
+
+    /**
+     * Get a checksum of the game state, for checking that two linked games
+     * are still in sync.
+     * 
+     * @return The checksum
+    */
+    uint8_t checksum()
+    {
+        uint8_t hash = 0;
+        int values[4] = {player1.getY(), player2.getY(), player1.score, player2.score};
+        hash = foldChecksum(hash, values, sizeof(values));
+        return ball.checksum(hash);
+    }
+
+    /**
+     * Update the game from the local buttons.
     */
     void update()
     {
-        if (digitalRead(2))
+        step(readInput(2, 3), readInput(4, 5));
+    }
+
+    /**
+     * Advance the game one tick. Only depends on the inputs, the game state
+     * and the ball's random stream, so two games with the same seed and
+     * inputs stay equal.
+     * 
+     * @param input1 The input of player 1
+     * @param input2 The input of player 2
+    */
+    void step(uint8_t input1, uint8_t input2)
+    {
+        if (input1 == PADDLE_UP)
         {
             player1.move(-1);
         }
-        else if (digitalRead(3))
+        else if (input1 == PADDLE_DOWN)
         {
             player1.move(1);
         }
 
-        if (digitalRead(4))
+        if (input2 == PADDLE_UP)
         {
             player2.move(-1);
         }
-        else if (digitalRead(5))
+        else if (input2 == PADDLE_DOWN)
         {
             player2.move(1);
         }
 
         if (ball.isGameOver())
         {
-            if (ball.getX() > 128)
+            if (ball.getX() > WIDTH)
             {
                 player1.score++;
             }
@@ -283,7 +421,11 @@ public:
             {
                 player2.score++;
             }
-            ball.reset(ball.getX() > 128 ? -1 : 1);
+            particles.burst(ball.getX() > WIDTH ? WIDTH - 1 : 0, HEIGHT / 2, 10);
+            ball.reset(ball.getX() > WIDTH ? -1 : 1);
+
+            score1.set(player1.score);
+            score2.set(player2.score);
         }
 
         ball.update();
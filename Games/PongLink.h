@@ -0,0 +1,452 @@
+/**
+ * @file PongLink.h
+ * 
+ * @brief Two player Pong between two boards over a serial link.
+ * 
+ * Both boards run the same Pong simulation in lockstep. Each board sends its
+ * paddle input for a tick a few ticks ahead (the input delay), and a tick is
+ * only simulated once the input of both boards for it is known. Since Pong
+ * only depends on the inputs and its random stream, which is seeded with the
+ * same value on both boards, the games stay equal. Each packet also carries a
+ * checksum of the sender's game state so a desync can be detected.
+ * 
+ * Inputs the other board has not acknowledged are sent again once the
+ * oldest of them has been out for longer than the round trip allows. The
+ * link owns Serial while it runs, so the log is paused until end().
+ * 
+ * Packet layout (9 bytes):
+ *   0x5A, type, a, b, c, d, e, checksum (low, high)
+ * HELLO: a, b = seed (low, high)
+ * INPUT: a = tick, b = input, c = ack, d = state tick, e = state checksum
+ * 
+ * The checksum is Fletcher-16 over type to e. After a lost byte the
+ * receiver tries every sync byte in the packet it was reading, and an 8 bit
+ * checksum let too many of those misaligned packets through.
+*/
+
+#ifndef PONG_LINK_H
+#define PONG_LINK_H
+
+#include "../system/Log.h"
+
+#define LINK_SYNC 0x5A
+#define LINK_HELLO 1
+#define LINK_INPUT 2
+#define LINK_PACKET 9
+#define LINK_BUFFER 16
+#define LINK_DELAY 3
+#define LINK_RESEND_MIN 50000UL
+
+/**
+ * Lockstep link between two Pong games
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+*/
+template <int WIDTH, int HEIGHT>
+class PongLink
+{
+private:
+    Pong<WIDTH, HEIGHT> *pong;
+    Stream *port;
+
+    uint8_t inputDelay = LINK_DELAY;
+
+    bool started = false;
+    bool isPlayer1;
+    uint16_t seed;
+    uint16_t peerSeed;
+    bool heardInput;
+    bool helloDue;
+
+    uint8_t tick;
+    uint8_t sendTick;
+    uint8_t acked;
+    uint8_t checked;
+
+    uint8_t local[LINK_BUFFER];
+    uint8_t remote[LINK_BUFFER];
+    uint16_t received;
+    uint8_t hashes[LINK_BUFFER];
+    unsigned long sentAt[LINK_BUFFER];
+    uint16_t resent;
+
+    uint8_t rx[LINK_PACKET];
+    uint8_t rxCount;
+
+    unsigned long resentAt;
+
+    unsigned long rtt;
+    unsigned int stalls;
+    unsigned int desyncs;
+
+    Digits rttText;
+    Digits stallText;
+    Digits desyncText;
+
+    /**
+     * Fletcher-16 checksum of the fields of a packet
+    */
+    uint16_t packetChecksum(const uint8_t *packet)
+    {
+        uint16_t a = 0, b = 0;
+        for (uint8_t i = 1; i < LINK_PACKET - 2; i++)
+        {
+            a = (a + packet[i]) % 255;
+            b = (b + a) % 255;
+        }
+        return b << 8 | a;
+    }
+
+    /**
+     * Send a packet.
+    */
+    void send(uint8_t type, uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+    {
+        uint8_t packet[LINK_PACKET] = {LINK_SYNC, type, a, b, c, d, e, 0, 0};
+        uint16_t check = packetChecksum(packet);
+        packet[LINK_PACKET - 2] = check;
+        packet[LINK_PACKET - 1] = check >> 8;
+        port->write(packet, LINK_PACKET);
+    }
+
+    void sendHello()
+    {
+        send(LINK_HELLO, seed, seed >> 8, 0, 0, 0);
+    }
+
+    /**
+     * Get the newest remote tick for which we have every input up to it.
+    */
+    uint8_t remoteAck()
+    {
+        uint8_t t = tick;
+        while ((uint8_t)(t - tick) < LINK_BUFFER && (received & bit(t % LINK_BUFFER)))
+        {
+            t++;
+        }
+        return t - 1;
+    }
+
+    /**
+     * Send our input for a tick, along with the remote inputs we have and
+     * the checksum of our current state.
+    */
+    void sendInput(uint8_t t)
+    {
+        send(LINK_INPUT, t, local[t % LINK_BUFFER], remoteAck(), tick, hashes[tick % LINK_BUFFER]);
+    }
+
+    /**
+     * Get how long an input may go unacknowledged before it is sent again:
+     * one and a half round trips, or LINK_RESEND_MIN before the first
+     * round trip has been measured.
+    */
+    unsigned long resendTimeout()
+    {
+        return max(rtt + rtt / 2, LINK_RESEND_MIN);
+    }
+
+    /**
+     * Send again the inputs the other board has not acknowledged, oldest
+     * first, as many as fit in the free transmit buffer so it never blocks.
+     * The rest go on a later resend if they are still missing.
+    */
+    void resend()
+    {
+        uint8_t t = acked + 1;
+        if ((uint8_t)(sendTick - t) > LINK_BUFFER)
+        {
+            t = sendTick - LINK_BUFFER;
+        }
+
+        int room = port->availableForWrite() / LINK_PACKET;
+        for (; t != sendTick && room > 0; t++, room--)
+        {
+            sendInput(t);
+            resent |= bit(t % LINK_BUFFER);
+        }
+    }
+
+    /**
+     * Start the game once both boards have found each other.
+     * 
+     * @param shared The seed both boards use
+    */
+    void start(uint16_t shared)
+    {
+        started = true;
+
+        // Pong seeds itself on init, so the shared seed goes after
+        pong->init();
+        pong->seed(shared);
+
+        tick = 0;
+        sendTick = inputDelay;
+        acked = inputDelay - 1;
+        checked = 0;
+
+        received = 0;
+        for (uint8_t t = 0; t < inputDelay; t++)
+        {
+            local[t] = 0;
+            remote[t] = 0;
+            received |= bit(t);
+        }
+        hashes[0] = pong->checksum();
+
+        heardInput = false;
+        helloDue = false;
+
+        resent = 0;
+        resentAt = micros();
+        rtt = 0;
+        stalls = 0;
+        desyncs = 0;
+    }
+
+    /**
+     * Handle a packet that has passed the checksum.
+    */
+    void receive(const uint8_t *packet)
+    {
+        if (packet[1] == LINK_HELLO)
+        {
+            uint16_t remoteSeed = packet[2] | packet[3] << 8;
+            if (started && remoteSeed == peerSeed)
+            {
+                // The other board has not seen our hello yet. Hellos queued
+                // while it waited must not each get an answer, so update()
+                // answers once per frame, and only until its first input.
+                if (!heardInput)
+                {
+                    helloDue = true;
+                }
+                return;
+            }
+
+            // Not started yet, or a new seed: the other board has left the
+            // game and come back, so start over with it
+            if (remoteSeed == seed)
+            {
+                seed = randomSource.next();
+                return;
+            }
+            isPlayer1 = seed > remoteSeed;
+            peerSeed = remoteSeed;
+            sendHello();
+            start(isPlayer1 ? seed : remoteSeed);
+            return;
+        }
+
+        if (packet[1] != LINK_INPUT || !started)
+        {
+            return;
+        }
+        heardInput = true;
+
+        uint8_t t = packet[2];
+        if ((uint8_t)(t - tick) < LINK_BUFFER)
+        {
+            remote[t % LINK_BUFFER] = packet[3];
+            received |= bit(t % LINK_BUFFER);
+        }
+
+        // Acks arrive in order, so one that goes back can only follow a
+        // corrupt packet that passed the checksum. Taking it puts the inputs
+        // after it back up for resending instead of waiting forever.
+        uint8_t ack = packet[4];
+        if ((uint8_t)(sendTick - 1 - ack) < LINK_BUFFER)
+        {
+            // The ack of a resent input could be for either copy, so it
+            // says nothing about the round trip
+            if (ack != acked && !(resent & bit(ack % LINK_BUFFER)))
+            {
+                rtt = micros() - sentAt[ack % LINK_BUFFER];
+            }
+            acked = ack;
+        }
+
+        uint8_t stateTick = packet[5];
+        if ((uint8_t)(tick - stateTick) < LINK_BUFFER && (uint8_t)(stateTick - checked) < LINK_BUFFER)
+        {
+            if (hashes[stateTick % LINK_BUFFER] != packet[6])
+            {
+                desyncs++;
+            }
+            checked = stateTick + 1;
+        }
+    }
+
+    /**
+     * Read any waiting bytes and handle complete packets.
+    */
+    void poll()
+    {
+        while (port->available() > 0)
+        {
+            uint8_t c = port->read();
+            if (rxCount == 0 && c != LINK_SYNC)
+            {
+                continue;
+            }
+            rx[rxCount++] = c;
+
+            if (rxCount < LINK_PACKET)
+            {
+                continue;
+            }
+            rxCount = 0;
+
+            if (packetChecksum(rx) == (rx[LINK_PACKET - 2] | rx[LINK_PACKET - 1] << 8))
+            {
+                receive(rx);
+                continue;
+            }
+
+            // A byte was lost, so the next packet may already have started
+            // inside this one
+            for (uint8_t i = 1; i < LINK_PACKET; i++)
+            {
+                if (rx[i] == LINK_SYNC)
+                {
+                    rxCount = LINK_PACKET - i;
+                    memmove(rx, rx + i, rxCount);
+                    break;
+                }
+            }
+        }
+    }
+
+public:
+    PongLink(){};
+
+    /**
+     * Start looking for the other board.
+     * 
+     * @param _pong The game to run
+     * @param _port The serial port connected to the other board
+     * @param u8g U8GLIB object for drawing to the screen
+     * @param _inputDelay Ticks between reading an input and using it
+    */
+    void begin(Pong<WIDTH, HEIGHT> *_pong, Stream *_port, U8GLIB *u8g, uint8_t _inputDelay = LINK_DELAY)
+    {
+        // A log frame on the port could hold the sync byte of a packet
+        logPause(true);
+
+        pong = _pong;
+        port = _port;
+        inputDelay = constrain(_inputDelay, 1, LINK_BUFFER / 2 - 1);
+
+        started = false;
+        rxCount = 0;
+        seed = randomSource.next();
+
+        pong->init();
+
+        rttText = Digits(u8g, WIDTH / 4, HEIGHT - DIGIT_HEIGHT - 1);
+        stallText = Digits(u8g, WIDTH * 3 / 4, HEIGHT - DIGIT_HEIGHT - 1);
+        desyncText = Digits(u8g, WIDTH / 2 + 9, HEIGHT - DIGIT_HEIGHT - 1);
+    }
+
+    /**
+     * Exchange inputs and advance the game if the inputs for the next tick
+     * have arrived. Never waits for the other board; a missing input counts
+     * as a stall and the tick is tried again on the next frame.
+    */
+    void update()
+    {
+        poll();
+
+        if (!started)
+        {
+            sendHello();
+            return;
+        }
+
+        if (helloDue)
+        {
+            sendHello();
+            helloDue = false;
+        }
+
+        if ((uint8_t)(sendTick - tick) <= inputDelay)
+        {
+            uint8_t slot = sendTick % LINK_BUFFER;
+            local[slot] = Pong<WIDTH, HEIGHT>::readInput(2, 3);
+            sentAt[slot] = micros();
+            resent &= ~bit(slot);
+            sendInput(sendTick);
+            sendTick++;
+        }
+
+        // Do not wait for the other board to stall: it is missing the input
+        // as soon as the ack is late
+        unsigned long now = micros();
+        uint8_t oldest = acked + 1;
+        if (oldest != sendTick &&
+            now - sentAt[oldest % LINK_BUFFER] >= resendTimeout() &&
+            now - resentAt >= resendTimeout())
+        {
+            resend();
+            resentAt = now;
+        }
+
+        uint8_t slot = tick % LINK_BUFFER;
+        if (!(received & bit(slot)))
+        {
+            stalls++;
+            return;
+        }
+        received &= ~bit(slot);
+
+        if (isPlayer1)
+        {
+            pong->step(local[slot], remote[slot]);
+        }
+        else
+        {
+            pong->step(remote[slot], local[slot]);
+        }
+
+        tick++;
+        hashes[tick % LINK_BUFFER] = pong->checksum();
+    }
+
+    /**
+     * Draw the round-trip time in milliseconds and the stall count, and the
+     * desync count if there has been one.
+    */
+    void draw()
+    {
+        if (!started)
+        {
+            return;
+        }
+
+        rttText.set(rtt / 1000);
+        stallText.set(stalls > 9999 ? 9999 : stalls);
+        rttText.draw();
+        stallText.draw();
+
+        if (desyncs > 0)
+        {
+            desyncText.set(desyncs > 9999 ? 9999 : desyncs);
+            desyncText.draw();
+        }
+    }
+
+    /**
+     * Stop using the port and let the log have it back.
+    */
+    void end()
+    {
+        logPause(false);
+    }
+
+    unsigned long getRoundTrip() { return rtt; }
+    unsigned int getStalls() { return stalls; }
+    unsigned int getDesyncs() { return desyncs; }
+};
+
+#endif
@@ -4,94 +4,174 @@
  * @brief A snake game for the menu system.
 */
 
-int SQUARE_SIZE = 4;
-int GRID_X = 128 / SQUARE_SIZE;
-int GRID_Y = 64 / SQUARE_SIZE;
+#include "../system/Scheduler.h"
+#include "../system/Log.h"
+#include "../system/Random.h"
+#include "Particles.h"
+#include "SnakeAutopilot.h"
+#include "SnakeLevels.h"
+
+#define SQUARE_SIZE 4
+#define SNAKE_MAX 32
 
 /**
- * A food object for the snake game.
+ * A part of the snake
  * 
- * @param U8GLIB_SSD1306_128X64 object for drawing to the screen
+ * @tparam CELL Size of a grid square in pixels
+ * @param x X position of the part
+ * @param y Y position of the part
+ * @param u8g The display to draw to
 */
-class Food
+template <int CELL>
+class SnakePart
 {
 private:
-    int x, y;
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
 
 public:
-    Food(){};
-    Food(U8GLIB_SSD1306_128X64 *_u8g)
+    int x, y;
+
+    SnakePart() {}
+
+    SnakePart(int _x, int _y, U8GLIB *_u8g)
     {
-        randomSeed(analogRead(A5));
-        x = random(GRID_X);
-        y = random(GRID_Y);
+        x = _x;
+        y = _y;
         u8g = _u8g;
     }
 
-    /**
-     * Regenerate the food at a random position
-    */
-    void regenerate()
+    void draw()
     {
-        int oldX = x, oldY = y;
-        do {
-        randomSeed(analogRead(A5));
-        x = random(GRID_X);
-        y = random(GRID_Y);
-        } while (oldX == x && oldY == y);
+        u8g->drawBox(x * CELL, y * CELL, CELL, CELL);
     }
 
-    /**
-     * Get the X and Y position of the food
-     * 
-     * @return int X and Y position of the food
-    */
-    int getX() { return x; }
-    int getY() { return y; }
-
-    /**
-     * Draw the food to the screen.
-    */
-    void draw()
+    void setPosition(int _x, int _y)
     {
-        u8g->drawBox(x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE);
+        x = _x;
+        y = _y;
     }
 };
 
 /**
- * A part of the snake
+ * A food object for the snake game.
  * 
- * @param x X position of the part
- * @param y Y position of the part
- * @param u8g The display to draw to
+ * Finding a free spot is run as a task so a long search on a crowded grid is
+ * spread over several frames. The food is hidden until it has been placed.
+ * It is never placed on the snake or on a wall.
+ * 
+ * @tparam GRID_X Width of the grid in squares
+ * @tparam GRID_Y Height of the grid in squares
+ * @tparam CELL Size of a grid square in pixels
+ * @param u8g U8GLIB object for drawing to the screen
 */
-class SnakePart
+template <int GRID_X, int GRID_Y, int CELL>
+class Food : public Task
 {
 private:
-    U8GLIB_SSD1306_128X64 *u8g;
-
-public:
     int x, y;
+    U8GLIB *u8g;
+    Random rng;
 
-    SnakePart() {}
+    SnakePart<CELL> *tail;
+    int *snakeSize;
+    const SnakeLevel<GRID_X, GRID_Y, CELL> *level;
+
+    bool placed = true;
 
-    SnakePart(int _x, int _y, U8GLIB_SSD1306_128X64 *_u8g)
+    /**
+     * Check if the current position is covered by the snake
+     * 
+     * @return true if a part of the snake is on the food
+    */
+    bool onSnake()
+    {
+        for (int i = 0; i < *snakeSize; i++)
+        {
+            if (tail[i].x == x && tail[i].y == y)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    Food(){};
+    Food(U8GLIB *_u8g)
     {
-        x = _x;
-        y = _y;
         u8g = _u8g;
     }
 
-    void draw()
+    /**
+     * Set the snake the food has to avoid
+     * 
+     * @param _tail The parts of the snake
+     * @param _snakeSize Pointer to the number of parts in use
+     * @param _level The level with the walls to avoid
+     * @param _rng The random stream to place the food with
+    */
+    void attach(SnakePart<CELL> *_tail, int *_snakeSize, const SnakeLevel<GRID_X, GRID_Y, CELL> *_level, Random _rng)
     {
-        u8g->drawBox(x * SQUARE_SIZE, y * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE);
+        tail = _tail;
+        snakeSize = _snakeSize;
+        level = _level;
+        rng = _rng;
     }
 
-    void setPosition(int _x, int _y)
+    /**
+     * Regenerate the food at a random position. The search runs on the
+     * scheduler.
+    */
+    void regenerate()
     {
-        x = _x;
-        y = _y;
+        placed = false;
+        scheduler.add(this);
+    }
+
+    /**
+     * Search for a free spot, yielding when the budget runs out.
+    */
+    char run()
+    {
+        TASK_BEGIN();
+
+        do
+        {
+            x = rng.below(GRID_X);
+            y = rng.below(GRID_Y);
+            TASK_YIELD_IF_OVER_BUDGET();
+        } while (level->isWall(x, y) || onSnake());
+
+        placed = true;
+
+        TASK_END();
+    }
+
+    /**
+     * Check if the food is on the grid
+     * 
+     * @return true if the food has been placed
+    */
+    bool isPlaced() { return placed; }
+
+    /**
+     * Get the X and Y position of the food
+     * 
+     * @return int X and Y position of the food
+    */
+    int getX() { return x; }
+    int getY() { return y; }
+
+    /**
+     * Draw the food to the screen.
+    */
+    void draw()
+    {
+        if (!placed)
+        {
+            return;
+        }
+        u8g->drawBox(x * CELL, y * CELL, CELL, CELL);
     }
 };
 
@@ -102,11 +182,12 @@ public:
  * @param values The array to shift
  * @param size The size of the array
 */
-void shift(SnakePart values[], int size)
+template <class T>
+void shift(T values[], int size)
 {
-    Serial.println(values[0].x);
+    LOG_DEBUG(LOG_SNAKE_SHIFT, values[0].x);
 
-    SnakePart temp = values[size - 1], temp1;
+    T temp = values[size - 1], temp1;
     for (int i = 0; i < size; i++)
     {
         temp1 = values[i];
@@ -114,52 +195,135 @@ void shift(SnakePart values[], int size)
         temp = temp1;
     }
 
-    Serial.println(values[0].x);
+    LOG_DEBUG(LOG_SNAKE_SHIFT, values[0].x);
 }
 
 /**
  * A snake game
  * 
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen
+ * The grid size follows from the display size and the square size at
+ * compile time, so no position calculation needs a runtime multiply.
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @tparam CELL Size of a grid square in pixels
+ * @param u8g U8GLIB object for drawing to the screen
 */
+template <int WIDTH, int HEIGHT, int CELL = SQUARE_SIZE>
 class Snake
 {
 private:
-    U8GLIB_SSD1306_128X64 *u8g;
-    SnakePart tail[32];
-    Food food;
+    static const int GRID_X = WIDTH / CELL;
+    static const int GRID_Y = HEIGHT / CELL;
+
+    U8GLIB *u8g;
+    SnakePart<CELL> tail[SNAKE_MAX];
+    Food<GRID_X, GRID_Y, CELL> food;
+    SnakeAutopilot<GRID_X, GRID_Y> pilot;
+    SnakeLevel<GRID_X, GRID_Y, CELL> level;
 
     int xVel = 1;
     int yVel = 0;
 
     int snakeSize = 4;
 
+    uint8_t levelNumber = 0;
+    uint8_t cleared = 0;
+
+    bool autopilot = false;
+
+    /**
+     * Put a short snake back at the start of the current level.
+    */
+    void restart()
+    {
+        int row = level.getStartRow();
+        snakeSize = 4;
+        xVel = 1;
+        yVel = 0;
+        tail[0] = SnakePart<CELL>(3, row, u8g);
+        tail[1] = SnakePart<CELL>(2, row, u8g);
+        tail[2] = SnakePart<CELL>(1, row, u8g);
+        tail[3] = SnakePart<CELL>(0, row, u8g);
+        food.regenerate();
+    }
+
+    /**
+     * Load a level and start it from the beginning.
+     * 
+     * @param number The level, 0 for the open field
+    */
+    void startLevel(uint8_t number)
+    {
+        levelNumber = number;
+        level.load(levelNumber);
+        restart();
+    }
+
+    /**
+     * Change direction from the buttons
+    */
+    void readInput()
+    {
+        if (digitalRead(2) && xVel != 1)
+        {
+            xVel = -1;
+            yVel = 0;
+        }
+        else if (digitalRead(3) && xVel != -1)
+        {
+            xVel = 1;
+            yVel = 0;
+        }
+        else if (digitalRead(4) && yVel != 1)
+        {
+            xVel = 0;
+            yVel = -1;
+        }
+        else if (digitalRead(5) && yVel != -1)
+        {
+            xVel = 0;
+            yVel = 1;
+        }
+    }
+
 public:
     Snake() {};
 
-    Snake(U8GLIB_SSD1306_128X64 *_u8g)
-    {
-        u8g = _u8g;
-        food = Food(u8g);
-    };
+    Snake(U8GLIB *_u8g) : u8g(_u8g), food(_u8g) {}
 
     /**
      * Initialize the snake.
     */
     void init()
     {
-        Serial.println("Init snake");
-        tail[0] = SnakePart(3, 0, u8g);
-        tail[1] = SnakePart(2, 0, u8g);
-        tail[2] = SnakePart(1, 0, u8g);
-        tail[3] = SnakePart(0, 0, u8g);
+        LOG_INFO(LOG_SNAKE_INIT, 0);
+        food.attach(tail, &snakeSize, &level, randomSource.fork());
+        cleared = 0;
+        startLevel(0);
     }
 
     /**
-     * Draws the snake and the food
+     * Let the snake steer itself
+     * 
+     * @param enabled true to use the autopilot instead of the buttons
+    */
+    void setAutopilot(bool enabled) { autopilot = enabled; }
+
+    /**
+     * Get the score, which is the length of the snake plus the full length
+     * for every level cleared
+     * 
+     * @return The score
+    */
+    int getScore() { return cleared * SNAKE_MAX + snakeSize; }
+
+    /**
+     * Draws the level, the snake and the food
     */
     void draw()
     {
+        level.draw(u8g);
         food.draw();
 
         for (int i = 0; i < snakeSize; i++)
@@ -171,57 +335,144 @@ public:
     }
 
     /**
-     * Updates the snake's position and checks for collisions
+     * Updates the snake's position and checks for collisions. Eating at the
+     * full length moves on to the next level, and running into a wall starts
+     * the level again.
     */
     void update(void)
     {
-        if (tail[0].x == food.getX() && tail[0].y == food.getY()) {
-            tail[snakeSize] = SnakePart(tail[snakeSize - 1].x, tail[snakeSize - 1].y, u8g);
+        if (food.isPlaced() && tail[0].x == food.getX() && tail[0].y == food.getY()) {
+            particles.burst(food.getX() * CELL + CELL / 2, food.getY() * CELL + CELL / 2, 6);
+
+            // The snake plays at full length until it eats once more
+            if (snakeSize >= SNAKE_MAX)
+            {
+                cleared++;
+                startLevel(levelNumber < SNAKE_LEVELS ? levelNumber + 1 : 0);
+                return;
+            }
+
+            tail[snakeSize] = SnakePart<CELL>(tail[snakeSize - 1].x, tail[snakeSize - 1].y, u8g);
             snakeSize++;
             food.regenerate();
         }
 
-        if (digitalRead(2) && xVel != 1)
-        {
-            xVel = -1;
-            yVel = 0;
-        }
-        else if (digitalRead(3) && xVel != -1)
-        {
-            xVel = 1;
-            yVel = 0;
-        }
-        else if (digitalRead(4) && yVel != 1)
+        if (autopilot)
         {
-            xVel = 0;
-            yVel = -1;
+            pilot.steer(tail, snakeSize, level.getWalls(), food.isPlaced() ? food.getX() : -1, food.getY(), xVel, yVel);
         }
-        else if (digitalRead(5) && yVel != -1)
+        else
         {
-            xVel = 0;
-            yVel = 1;
+            readInput();
         }
 
-        if (tail[0].x > GRID_X)
+        shift(tail, snakeSize);
+
+        // Wrap around the edges straight away, so the head is always on the grid
+        tail[0].x = (tail[1].x + xVel + GRID_X) % GRID_X;
+        tail[0].y = (tail[1].y + yVel + GRID_Y) % GRID_Y;
+
+        if (level.isWall(tail[0].x, tail[0].y))
         {
-            tail[0].x = 0;
+            particles.burst(tail[0].x * CELL + CELL / 2, tail[0].y * CELL + CELL / 2, 10);
+            restart();
         }
-        if (tail[0].x < 0)
+    }
+
+#ifdef BENCHMARK
+    /**
+     * Stretch the snake to full length along the top row.
+    */
+    void stretch()
+    {
+        snakeSize = SNAKE_MAX;
+        for (int i = 0; i < SNAKE_MAX; i++)
         {
-            tail[0].x = GRID_X - 1;
+            tail[i] = SnakePart<CELL>(GRID_X - 1 - i, 0, u8g);
         }
-        if (tail[0].y > GRID_Y)
+    }
+
+    /**
+     * Time the update and a full frame with the snake at full length and the
+     * autopilot steering, then the load and a full frame of each level,
+     * printed as log text.
+     * 
+     * @param ticks The number of ticks to run
+    */
+    void benchmark(int ticks)
+    {
+        init();
+        autopilot = true;
+        stretch();
+
+        unsigned long updateMax = 0, updateTotal = 0;
+        unsigned long frameMax = 0, frameTotal = 0;
+
+        for (int i = 0; i < ticks; i++)
         {
-            tail[0].y = 0;
+            // Eating at full length moves on to the next level
+            if (levelNumber != 0 || snakeSize < SNAKE_MAX)
+            {
+                startLevel(0);
+                stretch();
+            }
+
+            unsigned long start = micros();
+            update();
+            scheduler.run();
+            unsigned long time = micros() - start;
+            updateTotal += time;
+            updateMax = max(updateMax, time);
+
+            start = micros();
+            u8g->firstPage();
+            do
+            {
+                draw();
+            } while (u8g->nextPage());
+            time = micros() - start;
+            frameTotal += time;
+            frameMax = max(frameMax, time);
         }
-        if (tail[0].y < 0)
+
+        autopilot = false;
+        scheduler.clear();
+
+        logText.print(F("Snake update avg/max: "));
+        logText.print(updateTotal / ticks);
+        logText.print('/');
+        logText.println(updateMax);
+        logText.print(F("Snake frame avg/max: "));
+        logText.print(frameTotal / ticks);
+        logText.print('/');
+        logText.println(frameMax);
+        logText.print(F("Autopilot fallbacks: "));
+        logText.print(pilot.fallbacks);
+        logText.print('/');
+        logText.println(pilot.searches);
+
+        for (uint8_t n = 1; n <= SNAKE_LEVELS; n++)
         {
-            tail[0].y = GRID_Y - 1;
-        }
+            unsigned long start = micros();
+            level.load(n);
+            unsigned long load = micros() - start;
 
-        shift(tail, snakeSize);
+            start = micros();
+            u8g->firstPage();
+            do
+            {
+                level.draw(u8g);
+            } while (u8g->nextPage());
+            unsigned long frame = micros() - start;
 
-        tail[0].x = tail[1].x + xVel;
-        tail[0].y = tail[1].y + yVel;
+            logText.print(F("Level "));
+            logText.print(n);
+            logText.print(F(" load/frame: "));
+            logText.print(load);
+            logText.print('/');
+            logText.println(frame);
+        }
+        level.load(0);
     }
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,213 @@
+/**
+ * @file SnakeAutopilot.h
+ * 
+ * @brief Lets the snake play itself, for the attract mode.
+ * 
+ * The path search is a breadth-first search from the food outwards over the
+ * wrap-around grid. Each grid row is one bit set, so a whole BFS layer is
+ * expanded with a few shifts per row instead of a queue of cells. The search
+ * stops as soon as a layer touches a square next to the head, and the head
+ * moves onto that square. Only AUTOPILOT_BUDGET layers are searched per
+ * tick; if the food is not found in that many, a safe move is made instead.
+ * Walls are just squares that start out visited.
+*/
+
+#ifndef SNAKE_AUTOPILOT_H
+#define SNAKE_AUTOPILOT_H
+
+#define AUTOPILOT_BUDGET 32
+
+/**
+ * Autopilot for the snake game
+ * 
+ * @tparam GRID_X Width of the grid in squares, at most 32
+ * @tparam GRID_Y Height of the grid in squares
+*/
+template <int GRID_X, int GRID_Y>
+class SnakeAutopilot
+{
+private:
+    static_assert(GRID_X <= 32, "A grid row must fit in 32 bits");
+
+    static const uint32_t ROW_MASK = GRID_X >= 32 ? 0xFFFFFFFFUL : (1UL << (GRID_X & 31)) - 1;
+
+    static int wrapX(int x) { return (x + GRID_X) % GRID_X; }
+    static int wrapY(int y) { return (y + GRID_Y) % GRID_Y; }
+
+    /**
+     * Get the squares next to every square in a row, on the same row.
+    */
+    static uint32_t sideways(uint32_t row)
+    {
+        uint32_t left = row << 1 | row >> (GRID_X - 1);
+        uint32_t right = row >> 1 | row << (GRID_X - 1);
+        return (left | right) & ROW_MASK;
+    }
+
+    /**
+     * Check if a square is set in a row bit set.
+    */
+    static bool isSet(const uint32_t *rows, int x, int y)
+    {
+        return rows[y] & (1UL << x);
+    }
+
+    /**
+     * Distance between two squares on the wrap-around grid.
+    */
+    static int distance(int x1, int y1, int x2, int y2)
+    {
+        int dx = abs(x1 - x2);
+        int dy = abs(y1 - y2);
+        return min(dx, GRID_X - dx) + min(dy, GRID_Y - dy);
+    }
+
+    /**
+     * Check if a square is covered by the snake, not counting the head.
+    */
+    template <class T>
+    static bool onSnake(const T *tail, int size, int x, int y)
+    {
+        for (int i = 1; i < size; i++)
+        {
+            if (tail[i].x == x && tail[i].y == y)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Pick a move that does not run into the snake or a wall, preferring
+     * ones that get closer to the food.
+    */
+    template <class T>
+    void safeMove(const T *tail, int size, const uint32_t *walls, int foodX, int foodY, int &xVel, int &yVel)
+    {
+        int headX = tail[0].x;
+        int headY = tail[0].y;
+
+        const int dirs[4][2] = {{xVel, yVel}, {yVel, xVel}, {-yVel, -xVel}, {-xVel, -yVel}};
+        int best = -1;
+        int bestDistance = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            int x = wrapX(headX + dirs[i][0]);
+            int y = wrapY(headY + dirs[i][1]);
+            if (isSet(walls, x, y) || onSnake(tail, size, x, y))
+            {
+                continue;
+            }
+
+            int d = distance(x, y, foodX, foodY);
+            if (best == -1 || d < bestDistance)
+            {
+                best = i;
+                bestDistance = d;
+            }
+        }
+
+        if (best != -1)
+        {
+            xVel = dirs[best][0];
+            yVel = dirs[best][1];
+        }
+    }
+
+public:
+    unsigned long searches = 0;
+    unsigned long fallbacks = 0;
+
+    /**
+     * Choose the next direction of the snake.
+     * 
+     * @param tail The parts of the snake, head first
+     * @param size The number of parts
+     * @param walls The walls of the level, one bit set per row
+     * @param foodX X position of the food, or -1 if there is none
+     * @param foodY Y position of the food
+     * @param xVel The X direction, updated in place
+     * @param yVel The Y direction, updated in place
+    */
+    template <class T>
+    void steer(const T *tail, int size, const uint32_t *walls, int foodX, int foodY, int &xVel, int &yVel)
+    {
+        uint32_t visited[GRID_Y];
+        uint32_t frontier[GRID_Y];
+
+        for (int y = 0; y < GRID_Y; y++)
+        {
+            visited[y] = walls[y];
+            frontier[y] = 0;
+        }
+        for (int i = 1; i < size; i++)
+        {
+            visited[tail[i].y] |= 1UL << tail[i].x;
+        }
+
+        int headX = tail[0].x;
+        int headY = tail[0].y;
+
+        searches++;
+
+        if (foodX < 0 || isSet(visited, foodX, foodY))
+        {
+            fallbacks++;
+            safeMove(tail, size, walls, wrapX(headX + xVel), wrapY(headY + yVel), xVel, yVel);
+            return;
+        }
+
+        frontier[foodY] = 1UL << foodX;
+        visited[foodY] |= frontier[foodY];
+
+        const int dirs[4][2] = {{xVel, yVel}, {yVel, xVel}, {-yVel, -xVel}, {-xVel, -yVel}};
+
+        for (int layer = 0; layer < AUTOPILOT_BUDGET; layer++)
+        {
+            // A square next to the head is in this layer, so it is one step
+            // closer to the food than the head
+            for (int i = 0; i < 4; i++)
+            {
+                int x = wrapX(headX + dirs[i][0]);
+                int y = wrapY(headY + dirs[i][1]);
+                if (isSet(frontier, x, y))
+                {
+                    xVel = dirs[i][0];
+                    yVel = dirs[i][1];
+                    return;
+                }
+            }
+
+            // Expand the layer in place. The row above has already been
+            // overwritten, so its old value is carried along.
+            uint32_t above = frontier[GRID_Y - 1];
+            uint32_t first = frontier[0];
+            uint32_t any = 0;
+
+            for (int y = 0; y < GRID_Y; y++)
+            {
+                uint32_t row = frontier[y];
+                uint32_t below = y == GRID_Y - 1 ? first : frontier[y + 1];
+
+                uint32_t next = (sideways(row) | above | below) & ~visited[y];
+                visited[y] |= next;
+                frontier[y] = next;
+                any |= next;
+
+                above = row;
+            }
+
+            if (!any)
+            {
+                break;
+            }
+        }
+
+        fallbacks++;
+        safeMove(tail, size, walls, foodX, foodY, xVel, yVel);
+    }
+};
+
+#endif
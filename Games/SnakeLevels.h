@@ -0,0 +1,239 @@
+/**
+ * @file SnakeLevels.h
+ * 
+ * @brief Obstacle levels for the snake game, stored compressed in flash.
+ * 
+ * A level is run-length encoded over the grid in row order. The first byte
+ * is the row the snake starts on. Each byte after it is one run: the top bit
+ * is set for walls and the low 7 bits hold the length minus one. Runs can
+ * cross the end of a row. The levels are made for a 32x16 grid, so all
+ * other grid sizes only get the open field.
+ * 
+ * Only the collision grid of the current level is kept in RAM, one bit per
+ * square. Drawing reads the runs from flash again for each page, which turns
+ * a run of walls into one box per row and skips the rows outside the page.
+*/
+
+#ifndef SNAKE_LEVELS_H
+#define SNAKE_LEVELS_H
+
+#define LEVEL_WIDTH 32
+#define LEVEL_HEIGHT 16
+#define LEVEL_WALL 0x80
+#define LEVEL_RUN 0x7F
+
+#define SNAKE_LEVELS 3
+
+/*
+ * ................................
+ * ................................
+ * ................................
+ * ......####################......
+ * ................................
+ * ................................
+ * ................................
+ * ................................
+ * ................................
+ * ................................
+ * ................................
+ * ................................
+ * ......####################......
+ * ................................
+ * ................................
+ * ................................
+*/
+const uint8_t levelBars[] PROGMEM = {
+    0x00, 0x65, 0x93, 0x7F, 0x7F, 0x0B, 0x93, 0x65};
+
+/*
+ * ###############....#############
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * ................................
+ * ................................
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * #..............................#
+ * ###############....#############
+*/
+const uint8_t levelBox[] PROGMEM = {
+    0x07, 0x8E, 0x03, 0x8D, 0x1D, 0x81, 0x1D, 0x81, 0x1D, 0x81, 0x1D, 0x81,
+    0x1D, 0x81, 0x1D, 0x80, 0x3F, 0x80, 0x1D, 0x81, 0x1D, 0x81, 0x1D, 0x81,
+    0x1D, 0x81, 0x1D, 0x81, 0x1D, 0x8F, 0x03, 0x8C};
+
+/*
+ * ######......############......##
+ * #..............................#
+ * #.......#..............#.......#
+ * #.......#..............#.......#
+ * #.......#######..#######.......#
+ * #..............................#
+ * ...............#...............#
+ * ...............#................
+ * #..............#................
+ * #..............#...............#
+ * #.......#######..#######.......#
+ * #.......#..............#.......#
+ * #.......#..............#.......#
+ * #..............................#
+ * #..............................#
+ * ######......############......##
+*/
+const uint8_t levelRooms[] PROGMEM = {
+    0x07, 0x85, 0x05, 0x8B, 0x05, 0x82, 0x1D, 0x81, 0x06, 0x80, 0x0D, 0x80,
+    0x06, 0x81, 0x06, 0x80, 0x0D, 0x80, 0x06, 0x81, 0x06, 0x86, 0x01, 0x86,
+    0x06, 0x81, 0x1D, 0x80, 0x0E, 0x80, 0x0E, 0x80, 0x0E, 0x80, 0x0F, 0x80,
+    0x0D, 0x80, 0x0F, 0x80, 0x0D, 0x80, 0x0E, 0x81, 0x06, 0x86, 0x01, 0x86,
+    0x06, 0x81, 0x06, 0x80, 0x0D, 0x80, 0x06, 0x81, 0x06, 0x80, 0x0D, 0x80,
+    0x06, 0x81, 0x1D, 0x81, 0x1D, 0x86, 0x05, 0x8B, 0x05, 0x81};
+
+const uint8_t *const snakeLevels[SNAKE_LEVELS] PROGMEM = {
+    levelBars,
+    levelBox,
+    levelRooms};
+
+/**
+ * The walls of the current level
+ * 
+ * Level 0 is the open field, levels 1 to SNAKE_LEVELS come from flash.
+ * 
+ * @tparam GRID_X Width of the grid in squares, at most 32
+ * @tparam GRID_Y Height of the grid in squares
+ * @tparam CELL Size of a grid square in pixels
+*/
+template <int GRID_X, int GRID_Y, int CELL>
+class SnakeLevel
+{
+private:
+    static const bool FITS = GRID_X == LEVEL_WIDTH && GRID_Y == LEVEL_HEIGHT;
+
+    uint32_t walls[GRID_Y];
+    const uint8_t *map = nullptr;
+    uint8_t startRow = 0;
+
+public:
+    /**
+     * Load a level and decode its walls into the collision grid.
+     * 
+     * @param number The level, 0 for the open field
+    */
+    void load(uint8_t number)
+    {
+        for (int y = 0; y < GRID_Y; y++)
+        {
+            walls[y] = 0;
+        }
+
+        map = nullptr;
+        startRow = 0;
+        if (!FITS || number == 0 || number > SNAKE_LEVELS)
+        {
+            return;
+        }
+
+        map = (const uint8_t *)pgm_read_ptr(&snakeLevels[number - 1]);
+        startRow = pgm_read_byte(map);
+
+        const uint8_t *run = map + 1;
+        int cell = 0;
+        while (cell < GRID_X * GRID_Y)
+        {
+            uint8_t code = pgm_read_byte(run++);
+            int end = cell + (code & LEVEL_RUN) + 1;
+
+            if (!(code & LEVEL_WALL))
+            {
+                cell = end;
+                continue;
+            }
+
+            // Set the part of the run on each row with one mask
+            while (cell < end)
+            {
+                int x = cell % GRID_X;
+                int length = min(end - cell, GRID_X - x);
+                uint32_t mask = length >= 32 ? 0xFFFFFFFFUL : (1UL << length) - 1;
+                walls[cell / GRID_X] |= mask << x;
+                cell += length;
+            }
+        }
+    }
+
+    /**
+     * Check if a square is a wall
+     * 
+     * @return true if the square is a wall
+    */
+    bool isWall(int x, int y) const
+    {
+        return walls[y] & (1UL << x);
+    }
+
+    /**
+     * Get the collision grid, one bit set per row
+    */
+    const uint32_t *getWalls() const { return walls; }
+
+    /**
+     * Get the row the snake starts on
+    */
+    uint8_t getStartRow() const { return startRow; }
+
+    /**
+     * Draw the walls that fall inside the current page.
+     * 
+     * @param u8g U8GLIB object for drawing to the screen
+    */
+    void draw(U8GLIB *u8g) const
+    {
+        if (map == nullptr)
+        {
+            return;
+        }
+
+        u8g_t *g = u8g->getU8g();
+        int first = g->current_page.y0 / CELL * GRID_X;
+        int last = (g->current_page.y1 / CELL + 1) * GRID_X;
+
+        const uint8_t *run = map + 1;
+        int cell = 0;
+        while (cell < last)
+        {
+            uint8_t code = pgm_read_byte(run++);
+            int end = cell + (code & LEVEL_RUN) + 1;
+
+            if (!(code & LEVEL_WALL) || end <= first)
+            {
+                cell = end;
+                continue;
+            }
+
+            if (cell < first)
+            {
+                cell = first;
+            }
+            if (end > last)
+            {
+                end = last;
+            }
+
+            // One box per row the run covers
+            while (cell < end)
+            {
+                int x = cell % GRID_X;
+                int length = min(end - cell, GRID_X - x);
+                u8g->drawBox(x * CELL, cell / GRID_X * CELL, length * CELL, CELL);
+                cell += length;
+            }
+        }
+    }
+};
+
+#endif
@@ -7,10 +7,34 @@
 
 #include <U8glib.h>
 #include <Wire.h>
-#include <TMM_matrix.h>
-#include <TMM_squarematrix.h>
+#include <EEPROM.h>
 
-#define MENU_LENGTH 3
+#define MENU_LENGTH 5
+
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+
+// Stream the screen over Serial, tools/mirror.py turns it into images
+// #define SCREEN_MIRROR
+
+// Print timings of the worst cases at boot, decoded by tools/logdecode.py
+// #define BENCHMARK
+
+// Let the snake play itself after the menu has been idle for a while
+// #define ATTRACT_MODE
+
+// Log button-to-screen latency per input path, decoded by tools/logdecode.py
+// #define LATENCY_TRACE
+
+// Drawing and update time per frame in microseconds the games lower their
+// quality to stay under. The I2C transfer to the display is not counted.
+// #define FRAME_BUDGET 40000
+
+// Replay a run with the random seed logged at boot, see system/Random.h
+// #define RANDOM_SEED 12345
+
+// Log level of the binary event log, see system/Log.h
+// #define LOG_LEVEL LOG_LEVEL_DEBUG
 
 #include "menu/Menu.h"
 
@@ -21,13 +45,19 @@ U8GLIB_SSD1306_128X64 u8g(U8G_I2C_OPT_NO_ACK);
 MenuItem* menuItems[MENU_LENGTH] = {
     new MenuItem("Snake", 0),
     new MenuItem("Pong", 1),
-    new MenuItem("3D Cube", 2)
+    new MenuItem("3D Cube", 2),
+    new MenuItem("Memory", 3),
+    new MenuItem("Link Pong", 4)
 };
 
-Menu menu(menuItems, &u8g);
+Menu<DISPLAY_WIDTH, DISPLAY_HEIGHT> menu(menuItems, &u8g);
 
 void setup() {
+#ifdef SCREEN_MIRROR
+    Serial.begin(115200);
+#else
     Serial.begin(9600);
+#endif
     menu.init();
     
 }
@@ -5,27 +5,61 @@
 */
 
 #include "MenuItem.h"
+#include "../system/Sleep.h"
+#include "../system/Storage.h"
+#include "../system/Log.h"
+#include "../system/Random.h"
+#include "../system/Governor.h"
+#include "../system/Watchdog.h"
+#include "../system/Ssd1306.h"
+
+#define ATTRACT_DELAY 30000
+
+#ifdef SCREEN_MIRROR
+#include "../system/Mirror.h"
+#endif
 
 /**
  * Menu class for a simple menu system.
  * 
  * @brief Menu object that handles the menu
  * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
  * @param menuItems Array of MenuItem objects.
- * @param u8g U8GLIB_SSD1306_128X64 object for drawing to the screen.s
+ * @param u8g U8GLIB object for drawing to the screen.s
 */
+template <int WIDTH, int HEIGHT>
 class Menu
 {
 private:
     MenuItem *menuItems[MENU_LENGTH];
-    U8GLIB_SSD1306_128X64 *u8g;
+    U8GLIB *u8g;
+
+    GameHandler<WIDTH, HEIGHT> gameHandler;
+
+    Storage storage;
+
+    Ssd1306<WIDTH, HEIGHT> display;
+
+    FrameGovernor governor;
 
-    GameHandler gameHandler;
+#ifdef SCREEN_MIRROR
+    Mirror<WIDTH, HEIGHT> mirror;
+#endif
 
     int currentMenu;
 
     bool isPlaying;
 
+    bool redraw;
+
+    bool attract;
+    bool waitRelease;
+    unsigned long lastInput;
+
+    unsigned long wakeLatency;
+
     /**
      * Draw the menu to the screen.
     */
@@ -39,7 +73,7 @@ private:
         u8g->setFontPosTop();
 
         h = u8g->getFontAscent() - u8g->getFontDescent();
-        w = u8g->getWidth();
+        w = WIDTH;
 
         for (i = 0; i < MENU_LENGTH; i++)
         {
@@ -55,21 +89,118 @@ private:
         }
     }
 
+    /**
+     * Slide the current screen out before switching between the menu and a
+     * game. The next frame draws the new screen over the blanked display.
+    */
+    void slideOut(void)
+    {
+        unsigned long sent = display.slideOut();
+        LOG_INFO(LOG_SLIDE_BYTES, sent);
+    }
+
+    /**
+     * Check if any of the buttons is pressed.
+    */
+    bool anyButton(void)
+    {
+        for (int pin = 2; pin <= 6; pin++)
+        {
+            if (digitalRead(pin))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Start a game at full quality.
+     * 
+     * @param game The id of the game
+    */
+    void startGame(int game)
+    {
+        isPlaying = true;
+        lastInput = millis();
+        gameHandler.setGame(game);
+        gameHandler.init();
+
+        governor.reset();
+        gameHandler.setQuality(governor.getLevel());
+    }
+
+    /**
+     * Start the snake playing itself.
+    */
+    void startAttract(void)
+    {
+        attract = true;
+        startGame(SNAKE_ID);
+        gameHandler.setAutopilot(true);
+        slideOut();
+    }
+
+    /**
+     * Go back to the menu from the attract mode. The button that stopped it
+     * is ignored until it is released.
+    */
+    void stopAttract(void)
+    {
+        isPlaying = false;
+        attract = false;
+        gameHandler.setAutopilot(false);
+        redraw = true;
+        waitRelease = true;
+        slideOut();
+    }
+
     /**
      * Update the menu.
     */
     void updateMenu(void)
     {
 
+        if (attract) {
+            if (anyButton()) {
+                stopAttract();
+            }
+            return;
+        }
+
         if (isPlaying) {
             if (digitalRead(6)) {
                 isPlaying = false;
+                gameHandler.end();
+                // The idle time for the attract mode starts on the menu
+                lastInput = millis();
+                redraw = true;
+                slideOut();
+
+                storage.submitScore(menuItems[currentMenu]->getGame(), gameHandler.getScore());
+                storage.setMenuPosition(currentMenu);
+                storage.commit();
             }
             return;
         }
 
+        if (anyButton())
+        {
+            lastInput = millis();
+        }
+
+        if (waitRelease)
+        {
+            waitRelease = anyButton();
+            return;
+        }
+
         if (digitalRead(3))
         {
+            redraw = true;
+#ifdef LATENCY_TRACE
+            latencyTracer.consume(TRACE_MOVE);
+#endif
             currentMenu++;
             if (currentMenu >= MENU_LENGTH)
             {
@@ -78,6 +209,10 @@ private:
         }
         else if (digitalRead(2))
         {
+            redraw = true;
+#ifdef LATENCY_TRACE
+            latencyTracer.consume(TRACE_MOVE);
+#endif
             if (currentMenu == 0)
             {
                 currentMenu = MENU_LENGTH;
@@ -86,26 +221,39 @@ private:
         }
         else if (digitalRead(5))
         {
-            isPlaying = true;
-            gameHandler.setGame(menuItems[currentMenu]->getGame());
-            gameHandler.init();
+#ifdef LATENCY_TRACE
+            latencyTracer.consume(TRACE_SELECT);
+#endif
+            startGame(menuItems[currentMenu]->getGame());
+            slideOut();
         }
     }
 
 public:
-    Menu(MenuItem *items[10], U8GLIB_SSD1306_128X64 *oled)
+    // The members are built in place. Assigning a temporary would put a
+    // whole GameHandler on the stack while the globals are constructed.
+    Menu(MenuItem *items[MENU_LENGTH], U8GLIB *oled)
+        : u8g(oled), gameHandler(oled, 0), display(oled)
+#ifdef SCREEN_MIRROR
+        , mirror(oled)
+#endif
     {
-        for (int i = 0; i < 10; i++)
+        for (int i = 0; i < MENU_LENGTH; i++)
         {
             menuItems[i] = items[i];
         }
-        u8g = oled;
 
         currentMenu = 0;
 
         isPlaying = false;
 
-        gameHandler = GameHandler(u8g, 0);
+        redraw = true;
+
+        attract = false;
+        waitRelease = false;
+        lastInput = 0;
+
+        wakeLatency = 0;
     }
 
     /**
@@ -113,40 +261,148 @@ public:
     */
     void init()
     {
+        startEntropy();
+
         Wire.begin();
         pinMode(2, INPUT);
         pinMode(3, INPUT);
         pinMode(4, INPUT);
         pinMode(5, INPUT);
         pinMode(6, INPUT);
+
+        initSleep();
+
+        storage.load();
+        if (storage.getMenuPosition() < MENU_LENGTH)
+        {
+            currentMenu = storage.getMenuPosition();
+        }
+
+        seedRandom();
+        LOG_INFO(LOG_RANDOM_SEED, bootSeed);
+
+#ifdef BENCHMARK
+        benchmarkParticles(u8g);
+        gameHandler.benchmark();
+#endif
+
+        // The formats go first so the host can decode the reports
+        logSendFormats();
+        reportMemory();
+        reportOverruns();
     }
 
     /**
-     * Draw the menu.
+     * Draw the menu. When nothing on the menu has changed, the MCU sleeps
+     * until a button is pressed instead of sending the same screen again.
+     * Each phase runs under the watchdog, which is stopped while sleeping.
+     * 
+     * The governor is given the time spent drawing and updating the game,
+     * which is what the quality level changes. Sending a page to the display
+     * in nextPage() takes longer than all of that at 100 kHz I2C and is the
+     * same at every level, so it is left out.
     */
     void loop()
     {
-        u8g->firstPage();
+        unsigned long work = 0;
 
-        do
+        if (isPlaying || redraw)
         {
+            watchPhase(WATCH_DRAW);
+            u8g->firstPage();
 
-            if (isPlaying)
+            do
             {
-                gameHandler.draw();
+                unsigned long pageStart = micros();
+
+                if (isPlaying)
+                {
+                    gameHandler.draw();
+                }
+                else
+                {
+                    drawMenu();
+                }
+
+                work += micros() - pageStart;
+
+#ifdef SCREEN_MIRROR
+                mirror.capture();
+#endif
+
+            } while (u8g->nextPage());
+
+            redraw = false;
+
+#ifdef LATENCY_TRACE
+            latencyTracer.frameDone();
+#endif
+
+            unsigned long latency = takeWakeLatency();
+            if (latency > 0)
+            {
+                wakeLatency = latency;
+                LOG_INFO(LOG_WAKE_LATENCY, wakeLatency > 0xFFFF ? 0xFFFF : wakeLatency);
+            }
+        }
+        else
+        {
+            watchPhase(WATCH_LOG);
+            logFlush();
+            watchStop();
+
+#ifdef ATTRACT_MODE
+            // Idle sleep keeps millis() running so the delay can be timed
+            if (millis() - lastInput >= ATTRACT_DELAY)
+            {
+                startAttract();
             }
             else
             {
-                drawMenu();
+                sleepUntilButton(SLEEP_MODE_IDLE);
             }
-
-        } while (u8g->nextPage());
+#else
+            sleepUntilButton();
+#endif
+        }
 
         if (isPlaying)
         {
+            watchPhase(WATCH_UPDATE);
+            unsigned long updateStart = micros();
             gameHandler.update();
+            work += micros() - updateStart;
+#ifdef LATENCY_TRACE
+            latencyTracer.consume(TRACE_GAME);
+#endif
+
+            if (governor.frame(work))
+            {
+                gameHandler.setQuality(governor.getLevel());
+            }
         }
 
+        watchPhase(WATCH_MENU);
         updateMenu();
+
+        watchPhase(WATCH_LOG);
+#ifdef LATENCY_TRACE
+        latencyTracer.report();
+#endif
+        logFlush();
+
+#ifdef LATENCY_TRACE
+        latencyTracer.discard();
+#endif
+    }
+
+    /**
+     * Get the time from the last wake-up to the end of the redraw it caused.
+     * 
+     * @return Latency in microseconds
+    */
+    unsigned long getWakeLatency()
+    {
+        return wakeLatency;
     }
 };
\ No newline at end of file
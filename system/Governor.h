@@ -0,0 +1,151 @@
+/**
+ * @file Governor.h
+ * 
+ * @brief Adaptive quality to keep the games inside a frame budget.
+ * 
+ * The menu times the work of each game frame, drawing the pages and the
+ * update, and hands the time to the governor. The I2C transfer of the pages
+ * is not counted: it takes about 95 ms per frame at 100 kHz whatever the
+ * quality, so a budget on the whole frame could never be met.
+ * 
+ * A few slow frames in a row step the quality down, a long run of frames
+ * with room to spare steps it back up. The two thresholds are far apart, so
+ * a game that sits close to the budget does not flip between two levels
+ * every frame. What each level means is up to the game, see
+ * GameHandler::setQuality().
+*/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include "Log.h"
+
+#ifndef FRAME_BUDGET
+#define FRAME_BUDGET 40000
+#endif
+
+#define QUALITY_LOW 0
+#define QUALITY_MEDIUM 1
+#define QUALITY_HIGH 2
+
+#define GOVERNOR_DOWN_FRAMES 4
+#define GOVERNOR_UP_FRAMES 60
+
+/**
+ * Steps a quality level up and down from measured frame times
+ * 
+ * @param budget The drawing and update time to stay under in microseconds
+*/
+class FrameGovernor
+{
+private:
+    unsigned long budget = FRAME_BUDGET;
+    uint8_t level = QUALITY_HIGH;
+
+    uint8_t slow = 0;
+    uint8_t fast = 0;
+    unsigned long total = 0;
+
+    /**
+     * Move to a new level and log it with the average frame time that made
+     * the governor move.
+    */
+    void change(uint8_t _level, uint8_t frames)
+    {
+        level = _level;
+        LOG_INFO(LOG_QUALITY, level);
+        LOG_INFO(LOG_FRAME_TIME, min(total / frames, 0xFFFFUL));
+
+        slow = 0;
+        fast = 0;
+        total = 0;
+    }
+
+public:
+    /**
+     * Start again from the highest quality, for a new game.
+    */
+    void reset()
+    {
+        level = QUALITY_HIGH;
+        slow = 0;
+        fast = 0;
+        total = 0;
+    }
+
+    /**
+     * Set the frame budget
+     * 
+     * @param _budget The drawing and update time to stay under in
+     *                microseconds
+    */
+    void setBudget(unsigned long _budget) { budget = _budget; }
+
+    /**
+     * Get the quality level the game should run at
+     * 
+     * @return QUALITY_LOW to QUALITY_HIGH
+    */
+    uint8_t getLevel() { return level; }
+
+    /**
+     * Count a frame towards the next decision.
+     * 
+     * @param time How long drawing and updating the frame took in
+     *             microseconds
+     * @return true if the level changed
+    */
+    bool frame(unsigned long time)
+    {
+        if (time > budget)
+        {
+            if (fast > 0)
+            {
+                fast = 0;
+                total = 0;
+            }
+            total += time;
+
+            if (++slow >= GOVERNOR_DOWN_FRAMES)
+            {
+                if (level > QUALITY_LOW)
+                {
+                    change(level - 1, slow);
+                    return true;
+                }
+                slow = 0;
+                total = 0;
+            }
+            return false;
+        }
+
+        if (slow > 0)
+        {
+            slow = 0;
+            total = 0;
+        }
+
+        // Only frames with a quarter of the budget to spare count as fast
+        if (time > budget - budget / 4)
+        {
+            fast = 0;
+            total = 0;
+            return false;
+        }
+        total += time;
+
+        if (++fast >= GOVERNOR_UP_FRAMES)
+        {
+            if (level < QUALITY_HIGH)
+            {
+                change(level + 1, fast);
+                return true;
+            }
+            fast = 0;
+            total = 0;
+        }
+        return false;
+    }
+};
+
+#endif
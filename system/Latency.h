@@ -0,0 +1,158 @@
+/**
+ * @file Latency.h
+ * 
+ * @brief Input-to-photon latency tracing.
+ * 
+ * The time of a button press is taken in the pin change interrupt. When the
+ * menu or a game acts on the press, it is tagged with a path, and the time
+ * until the end of the next frame sent to the display is recorded for that
+ * path. Every TRACE_REPORT_EVERY samples the statistics are logged as
+ * events, one path per frame so the report never fills the log ring.
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "Log.h"
+
+#define TRACE_NONE -1
+#define TRACE_MOVE 0
+#define TRACE_SELECT 1
+#define TRACE_GAME 2
+#define TRACE_PATHS 3
+
+#define TRACE_REPORT_EVERY 16
+
+/**
+ * Latency statistics for one path
+*/
+struct LatencyStats
+{
+    unsigned int count;
+    unsigned long min;
+    unsigned long max;
+    unsigned long total;
+
+    void add(unsigned long latency)
+    {
+        if (count == 0 || latency < min)
+        {
+            min = latency;
+        }
+        if (latency > max)
+        {
+            max = latency;
+        }
+        total += latency;
+        count++;
+    }
+};
+
+/**
+ * Tracer that follows button presses until they reach the screen
+*/
+class LatencyTracer
+{
+private:
+    volatile bool pending = false;
+    volatile unsigned long pressedAt;
+    uint8_t lastPins = 0;
+
+    int8_t armed = TRACE_NONE;
+    unsigned long armedAt;
+
+    LatencyStats stats[TRACE_PATHS];
+    unsigned int samples = 0;
+    int8_t reporting = TRACE_NONE;
+
+public:
+    /**
+     * Record a pin change. Called from the pin change interrupt.
+     * 
+     * @param pins The current state of the button pins
+     * @param now The time of the change in microseconds
+    */
+    void edge(uint8_t pins, unsigned long now)
+    {
+        uint8_t pressed = pins & ~lastPins;
+        lastPins = pins;
+
+        if (pressed && !pending)
+        {
+            pressedAt = now;
+            pending = true;
+        }
+    }
+
+    /**
+     * Tag the oldest unhandled press with the path that acted on it.
+     * 
+     * @param path TRACE_MOVE, TRACE_SELECT or TRACE_GAME
+    */
+    void consume(int8_t path)
+    {
+        cli();
+        if (pending && armed == TRACE_NONE)
+        {
+            armed = path;
+            armedAt = pressedAt;
+            pending = false;
+        }
+        sei();
+    }
+
+    /**
+     * Forget a press nothing acted on, so it is not counted against a later
+     * one.
+    */
+    void discard()
+    {
+        pending = false;
+    }
+
+    /**
+     * Mark the end of a frame. A tagged press is now on the screen.
+    */
+    void frameDone()
+    {
+        if (armed == TRACE_NONE)
+        {
+            return;
+        }
+
+        stats[armed].add(micros() - armedAt);
+        armed = TRACE_NONE;
+
+        if (++samples % TRACE_REPORT_EVERY == 0)
+        {
+            reporting = 0;
+        }
+    }
+
+    /**
+     * Log the statistics of the next path of a report that is due, in
+     * milliseconds. Called once per frame, after the frame has been timed.
+    */
+    void report()
+    {
+        while (reporting != TRACE_NONE && stats[reporting].count == 0)
+        {
+            reporting = reporting + 1 < TRACE_PATHS ? reporting + 1 : TRACE_NONE;
+        }
+        if (reporting == TRACE_NONE)
+        {
+            return;
+        }
+
+        LOG_INFO(LOG_LATENCY_MOVE + reporting, stats[reporting].total / stats[reporting].count / 1000);
+        LOG_INFO(LOG_LATENCY_MIN, stats[reporting].min / 1000);
+        LOG_INFO(LOG_LATENCY_MAX, stats[reporting].max / 1000);
+        LOG_INFO(LOG_LATENCY_COUNT, stats[reporting].count);
+
+        reporting = reporting + 1 < TRACE_PATHS ? reporting + 1 : TRACE_NONE;
+    }
+};
+
+LatencyTracer latencyTracer;
+
+#endif
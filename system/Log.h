@@ -0,0 +1,321 @@
+/**
+ * @file Log.h
+ * 
+ * @brief Binary event logging with compile-time levels.
+ * 
+ * An event is one ID byte and a 16 bit argument, written into a small ring
+ * buffer. Nothing is formatted on the device: the format strings live in
+ * flash and are sent once at boot, so a host can turn the events back into
+ * text. logFlush() moves only as many whole events as fit in the free Serial
+ * transmit buffer, and the Serial interrupt sends them from there, so logging
+ * never blocks. If the ring is full the event is dropped and counted.
+ * 
+ * Everything sent over Serial is framed the same way, so the log can share
+ * the port with the screen mirror and a host can find the start of a frame
+ * in the middle of the stream:
+ *   0xA5, type, length, payload[length], checksum
+ * 
+ * The checksum is the XOR of type, length and the payload. Types below 0x80
+ * are screen mirror segments, see Mirror.h. The log uses:
+ *   LOG_FRAME_EVENT:  id, argument (low), argument (high)
+ *   LOG_FRAME_FORMAT: id, text
+ *   LOG_FRAME_TEXT:   text, for the reports printed with logText
+ * 
+ * Another user of the port, such as the Pong link, pauses the log while it
+ * runs. tools/logdecode.py turns the stream back into text. Levels below LOG_LEVEL
+ * compile to nothing.
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_BUFFER 32
+
+#define LOG_SYNC 0xA5
+#define LOG_FRAME_EVENT 0x80
+#define LOG_FRAME_FORMAT 0x81
+#define LOG_FRAME_TEXT 0x82
+#define LOG_FRAME_SIZE 7
+#define LOG_TEXT_BUFFER 16
+
+/**
+ * Event IDs. Each needs a format string in logFormats.
+*/
+enum LogEvent
+{
+    LOG_DROPPED,
+    LOG_SNAKE_INIT,
+    LOG_SNAKE_SHIFT,
+    LOG_WAKE_LATENCY,
+    LOG_SLIDE_BYTES,
+    LOG_RANDOM_SEED,
+    LOG_QUALITY,
+    LOG_FRAME_TIME,
+    LOG_WATCHDOG_RESET,
+    LOG_OVERRUN_COUNT,
+    LOG_OVERRUN,
+    LOG_OVERRUN_UPTIME,
+    LOG_I2C_STUCK,
+    LOG_LATENCY_MOVE,
+    LOG_LATENCY_SELECT,
+    LOG_LATENCY_GAME,
+    LOG_LATENCY_MIN,
+    LOG_LATENCY_MAX,
+    LOG_LATENCY_COUNT,
+    LOG_EVENT_COUNT
+};
+
+const char logFormatDropped[] PROGMEM = "Dropped %u events";
+const char logFormatSnakeInit[] PROGMEM = "Init snake";
+const char logFormatSnakeShift[] PROGMEM = "Snake head x %d";
+const char logFormatWakeLatency[] PROGMEM = "Wake %u us";
+const char logFormatSlideBytes[] PROGMEM = "Slide sent %u bytes";
+const char logFormatRandomSeed[] PROGMEM = "Random seed %u";
+const char logFormatQuality[] PROGMEM = "Quality level %u";
+const char logFormatFrameTime[] PROGMEM = "Average frame work %u us";
+const char logFormatWatchdogReset[] PROGMEM = "Watchdog reset in phase %u";
+const char logFormatOverrunCount[] PROGMEM = "Overruns: %u";
+const char logFormatOverrun[] PROGMEM = "  phase %u (1 draw, 2 update, 3 menu, 4 log)";
+const char logFormatOverrunUptime[] PROGMEM = "    at %u s";
+const char logFormatI2cStuck[] PROGMEM = "    I2C bus stuck, freed %u";
+const char logFormatLatencyMove[] PROGMEM = "Move latency avg %u ms";
+const char logFormatLatencySelect[] PROGMEM = "Select latency avg %u ms";
+const char logFormatLatencyGame[] PROGMEM = "Game latency avg %u ms";
+const char logFormatLatencyMin[] PROGMEM = "  min %u ms";
+const char logFormatLatencyMax[] PROGMEM = "  max %u ms";
+const char logFormatLatencyCount[] PROGMEM = "  samples %u";
+
+const char *const logFormats[LOG_EVENT_COUNT] PROGMEM = {
+    logFormatDropped,
+    logFormatSnakeInit,
+    logFormatSnakeShift,
+    logFormatWakeLatency,
+    logFormatSlideBytes,
+    logFormatRandomSeed,
+    logFormatQuality,
+    logFormatFrameTime,
+    logFormatWatchdogReset,
+    logFormatOverrunCount,
+    logFormatOverrun,
+    logFormatOverrunUptime,
+    logFormatI2cStuck,
+    logFormatLatencyMove,
+    logFormatLatencySelect,
+    logFormatLatencyGame,
+    logFormatLatencyMin,
+    logFormatLatencyMax,
+    logFormatLatencyCount};
+
+uint8_t logRing[LOG_BUFFER];
+uint8_t logHead = 0;
+uint8_t logTail = 0;
+uint16_t logDropped = 0;
+bool logPaused = false;
+
+/**
+ * Add an event to the ring, or count it as dropped if there is no room.
+ * 
+ * @param id The event ID
+ * @param arg The argument
+*/
+inline void logEvent(uint8_t id, uint16_t arg)
+{
+    uint8_t used = (logHead - logTail) & (LOG_BUFFER - 1);
+    if (used > LOG_BUFFER - 4)
+    {
+        logDropped++;
+        return;
+    }
+
+    logRing[logHead] = id;
+    logRing[(logHead + 1) & (LOG_BUFFER - 1)] = arg;
+    logRing[(logHead + 2) & (LOG_BUFFER - 1)] = arg >> 8;
+    logHead = (logHead + 3) & (LOG_BUFFER - 1);
+}
+
+/**
+ * Send one frame. Blocks until it is all in the Serial transmit buffer.
+ * 
+ * @param type The frame type
+ * @param data The payload
+ * @param length The number of payload bytes
+*/
+void logFrame(uint8_t type, const uint8_t *data, uint8_t length)
+{
+    uint8_t check = type ^ length;
+
+    Serial.write(LOG_SYNC);
+    Serial.write(type);
+    Serial.write(length);
+    for (uint8_t i = 0; i < length; i++)
+    {
+        check ^= data[i];
+        Serial.write(data[i]);
+    }
+    Serial.write(check);
+}
+
+/**
+ * Keep the log off Serial while something else owns the port. Events wait
+ * in the ring, or are counted as dropped once it is full, and text is
+ * thrown away.
+ * 
+ * @param paused true to pause, false to carry on
+*/
+void logPause(bool paused)
+{
+    logPaused = paused;
+}
+
+/**
+ * Move buffered events into the Serial transmit buffer without waiting.
+ * Only whole frames are written, so a frame is never cut by another writer.
+*/
+void logFlush()
+{
+    if (logPaused)
+    {
+        return;
+    }
+
+    if (logDropped > 0 && ((logHead - logTail) & (LOG_BUFFER - 1)) <= LOG_BUFFER - 4)
+    {
+        uint16_t dropped = logDropped;
+        logDropped = 0;
+        logEvent(LOG_DROPPED, dropped);
+    }
+
+    while (logTail != logHead && Serial.availableForWrite() >= LOG_FRAME_SIZE)
+    {
+        uint8_t frame[LOG_FRAME_SIZE];
+        frame[0] = LOG_SYNC;
+        frame[1] = LOG_FRAME_EVENT;
+        frame[2] = 3;
+        frame[6] = LOG_FRAME_EVENT ^ 3;
+        for (uint8_t i = 3; i < 6; i++)
+        {
+            frame[i] = logRing[logTail];
+            frame[6] ^= frame[i];
+            logTail = (logTail + 1) & (LOG_BUFFER - 1);
+        }
+        Serial.write(frame, LOG_FRAME_SIZE);
+    }
+}
+
+/**
+ * Send every event in the ring, waiting for room in the transmit buffer.
+ * For boot, where a report can log more events than the ring holds.
+*/
+void logDrain()
+{
+    while (logTail != logHead && !logPaused)
+    {
+        logFlush();
+    }
+}
+
+/**
+ * Send the format strings so the host can decode the events. Blocks, so it
+ * is only meant for boot.
+*/
+void logSendFormats()
+{
+    for (uint8_t id = 0; id < LOG_EVENT_COUNT; id++)
+    {
+        const char *format = (const char *)pgm_read_ptr(&logFormats[id]);
+        uint8_t length = strlen_P(format);
+
+        uint8_t check = LOG_FRAME_FORMAT ^ (length + 1) ^ id;
+
+        Serial.write(LOG_SYNC);
+        Serial.write(LOG_FRAME_FORMAT);
+        Serial.write(length + 1);
+        Serial.write(id);
+        for (uint8_t i = 0; i < length; i++)
+        {
+            uint8_t c = pgm_read_byte(format + i);
+            check ^= c;
+            Serial.write(c);
+        }
+        Serial.write(check);
+    }
+}
+
+/**
+ * Text sent as log frames, for the reports that are printed at boot or by
+ * the debug options. Used like Serial: logText.print(). The text is sent a
+ * line at a time, or sooner if the line does not fit in the buffer. Blocks
+ * like Serial does when the transmit buffer is full.
+*/
+class LogText : public Print
+{
+private:
+    uint8_t buffer[LOG_TEXT_BUFFER];
+    uint8_t length = 0;
+
+public:
+    size_t write(uint8_t c)
+    {
+        if (logPaused)
+        {
+            return 1;
+        }
+
+        buffer[length++] = c;
+        if (c == '\n' || length == LOG_TEXT_BUFFER)
+        {
+            flush();
+        }
+        return 1;
+    }
+
+    /**
+     * Send what is buffered.
+    */
+    void flush()
+    {
+        if (length > 0)
+        {
+            logFrame(LOG_FRAME_TEXT, buffer, length);
+            length = 0;
+        }
+    }
+};
+
+LogText logText;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(id, arg) logEvent(id, arg)
+#else
+#define LOG_ERROR(id, arg)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(id, arg) logEvent(id, arg)
+#else
+#define LOG_WARN(id, arg)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(id, arg) logEvent(id, arg)
+#else
+#define LOG_INFO(id, arg)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(id, arg) logEvent(id, arg)
+#else
+#define LOG_DEBUG(id, arg)
+#endif
+
+#endif
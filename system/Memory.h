@@ -0,0 +1,210 @@
+/**
+ * @file Memory.h
+ * 
+ * @brief SRAM diagnostics for the menu system.
+ * 
+ * The free area between the heap and the stack is painted with a canary
+ * value before setup() runs. Scanning for the first overwritten byte later
+ * gives the deepest the stack has ever reached.
+*/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "Log.h"
+
+#define STACK_CANARY 0xC5
+
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+/**
+ * Paint the unused RAM with the canary value.
+ * 
+ * Placed in .init3 so it runs after the stack pointer is set up but before
+ * any global constructors allocate from the heap.
+*/
+void paintStack(void) __attribute__((naked, used, section(".init3")));
+void paintStack(void)
+{
+    uint8_t *p = &__heap_start;
+    uint8_t *top = (uint8_t *)SP;
+
+    while (p < top)
+    {
+        *p++ = STACK_CANARY;
+    }
+}
+
+/**
+ * Get the current end of the heap.
+ * 
+ * @return Pointer to the first byte after the heap
+*/
+uint8_t *heapEnd()
+{
+    return __brkval == 0 ? &__heap_start : (uint8_t *)__brkval;
+}
+
+/**
+ * Get the number of bytes allocated on the heap.
+ * 
+ * @return Heap usage in bytes
+*/
+int heapUsed()
+{
+    return heapEnd() - &__heap_start;
+}
+
+/**
+ * Get the number of free bytes between the heap and the stack right now.
+ * 
+ * @return Free RAM in bytes
+*/
+int freeMemory()
+{
+    uint8_t top;
+    return &top - heapEnd();
+}
+
+/**
+ * Get the number of bytes between the heap and the deepest point the stack
+ * has ever reached.
+ * 
+ * @return Untouched RAM in bytes
+*/
+int stackHeadroom()
+{
+    uint8_t *p = heapEnd();
+    uint8_t *top = (uint8_t *)SP;
+
+    while (p < top && *p == STACK_CANARY)
+    {
+        p++;
+    }
+    return p - heapEnd();
+}
+
+/**
+ * Get the largest stack depth seen since boot.
+ * 
+ * @return Stack high-water mark in bytes
+*/
+int stackHighWater()
+{
+    return (uint8_t *)RAMEND - heapEnd() - stackHeadroom();
+}
+
+/**
+ * Print the memory usage as log text.
+*/
+void reportMemory()
+{
+    logText.print(F("Free: "));
+    logText.println(freeMemory());
+    logText.print(F("Headroom: "));
+    logText.println(stackHeadroom());
+    logText.print(F("Stack max: "));
+    logText.println(stackHighWater());
+    logText.print(F("Heap: "));
+    logText.println(heapUsed());
+}
+
+/**
+ * A screen showing the memory usage, selectable from the menu like a game.
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object for drawing to the screen
+ * @param names The names of the games to list
+ * @param sizes The static footprint of each game in bytes
+ * @param count The number of games
+*/
+template <int WIDTH, int HEIGHT>
+class MemoryScreen
+{
+private:
+    U8GLIB *u8g;
+
+    const char *const *names;
+    const int *sizes;
+    int count;
+
+    int free;
+    int headroom;
+    int heap;
+
+    /**
+     * Draw a label and a value on one row.
+    */
+    void drawRow(int row, const char *label, int value)
+    {
+        if (row >= HEIGHT / 10)
+        {
+            return;
+        }
+
+
+        char text[8];
+        itoa(value, text, 10);
+        u8g->drawStr(0, row * 10, label);
+        u8g->drawStr(WIDTH - u8g->getStrWidth(text), row * 10, text);
+    }
+
+public:
+    MemoryScreen(){};
+    MemoryScreen(U8GLIB *_u8g, const char *const *_names, const int *_sizes, int _count)
+    {
+        u8g = _u8g;
+        names = _names;
+        sizes = _sizes;
+        count = _count;
+    }
+
+    /**
+     * Initialize the screen and print a report as log text.
+    */
+    void init()
+    {
+        update();
+
+        reportMemory();
+        for (int i = 0; i < count; i++)
+        {
+            logText.print(names[i]);
+            logText.print(F(": "));
+            logText.println(sizes[i]);
+        }
+    }
+
+    /**
+     * Draw the memory usage.
+    */
+    void draw()
+    {
+        u8g->setFont(u8g_font_6x13);
+        u8g->setFontRefHeightText();
+        u8g->setFontPosTop();
+
+        drawRow(0, "Free", free);
+        drawRow(1, "Headroom", headroom);
+        drawRow(2, "Heap", heap);
+
+        for (int i = 0; i < count && i < 3; i++)
+        {
+            drawRow(3 + i, names[i], sizes[i]);
+        }
+    }
+
+    /**
+     * Sample the memory usage. Done once per frame rather than per page.
+    */
+    void update()
+    {
+        free = freeMemory();
+        headroom = stackHeadroom();
+        heap = heapUsed();
+    }
+};
+
+#endif
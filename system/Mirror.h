@@ -0,0 +1,197 @@
+/**
+ * @file Mirror.h
+ * 
+ * @brief Streams the screen contents over Serial for remote viewing.
+ * 
+ * Each page is split into segments of 32 columns. A segment is
+ * only sent when its checksum differs from the last one sent, and only if it
+ * fits in the free space of the Serial transmit buffer, so the game loop is
+ * never blocked. A segment that is skipped keeps its old checksum and is
+ * sent on a later frame.
+ * 
+ * One more segment is sent each frame whether it changed or not, going
+ * round the screen in turn. A host that connects late or loses a packet
+ * has the whole screen again after one frame per segment, static parts
+ * like the menu or the Snake walls included. Nothing is sent while the menu
+ * sleeps, since no frames are drawn.
+ * 
+ * A segment is sent as a frame of the Serial stream, see Log.h, with the id
+ * (page * segments per page + segment) as the frame type:
+ *   0xA5, id, length, data[length], checksum
+ * 
+ * The checksum is the XOR of id, length and the data. The data is PackBits
+ * style RLE: a control byte below 0x80 is followed by one byte repeated
+ * (control + 1) times, a control byte of 0x80 or more is followed by
+ * (control - 0x7F) literal bytes. Each decoded byte is one column of eight
+ * pixels with the least significant bit at the top, as on the SSD1306.
+ * 
+ * tools/mirror.py writes the frames out as PBM images and skips the log
+ * frames that share the port.
+*/
+
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include "Log.h"
+
+#define MIRROR_SYNC LOG_SYNC
+#define MIRROR_SEGMENT 32
+#define MIRROR_MAX_RUN 0x80
+#define MIRROR_PACKET (MIRROR_SEGMENT + MIRROR_SEGMENT / MIRROR_MAX_RUN + 5)
+
+/**
+ * Mirror of the screen over Serial
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object whose page buffer is captured
+*/
+template <int WIDTH, int HEIGHT>
+class Mirror
+{
+private:
+    static const uint8_t MIRROR_SEGMENTS = WIDTH / MIRROR_SEGMENT;
+    static const uint8_t MIRROR_PAGES = HEIGHT / 8;
+
+    U8GLIB *u8g;
+
+    uint16_t sent[MIRROR_PAGES * MIRROR_SEGMENTS];
+    uint8_t refresh = 0;
+
+    /**
+     * Fletcher-16 checksum of a segment. Neither half can reach 0xFF, so
+     * 0xFFFF never matches a real segment.
+    */
+    uint16_t fletcher(const uint8_t *data, uint8_t length)
+    {
+        uint16_t a = 0, b = 0;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            a = (a + data[i]) % 255;
+            b = (b + a) % 255;
+        }
+        return b << 8 | a;
+    }
+
+    /**
+     * Compress a segment with RLE.
+     * 
+     * @param data The bytes to compress
+     * @param length The number of bytes
+     * @param out Buffer for the compressed bytes
+     * @return The number of compressed bytes
+    */
+    uint8_t encode(const uint8_t *data, uint8_t length, uint8_t *out)
+    {
+        uint8_t n = 0;
+        uint8_t i = 0;
+
+        while (i < length)
+        {
+            uint8_t run = 1;
+            while (i + run < length && run < MIRROR_MAX_RUN && data[i + run] == data[i])
+            {
+                run++;
+            }
+
+            if (run >= 3)
+            {
+                out[n++] = run - 1;
+                out[n++] = data[i];
+                i += run;
+                continue;
+            }
+
+            // Collect literals until the next run of three or more
+            uint8_t start = i;
+            while (i < length && i - start < MIRROR_MAX_RUN &&
+                   !(i + 2 < length && data[i] == data[i + 1] && data[i] == data[i + 2]))
+            {
+                i++;
+            }
+            out[n++] = 0x7F + (i - start);
+            for (uint8_t j = start; j < i; j++)
+            {
+                out[n++] = data[j];
+            }
+        }
+
+        return n;
+    }
+
+public:
+    Mirror(){};
+    Mirror(U8GLIB *_u8g)
+    {
+        u8g = _u8g;
+        invalidate();
+    }
+
+    /**
+     * Send the whole screen again on the next frame.
+    */
+    void invalidate()
+    {
+        for (int i = 0; i < MIRROR_PAGES * MIRROR_SEGMENTS; i++)
+        {
+            sent[i] = 0xFFFF;
+        }
+    }
+
+    /**
+     * Capture the page that has just been drawn. Must be called inside the
+     * picture loop, before nextPage() clears the buffer.
+    */
+    void capture()
+    {
+        u8g_pb_t *pb = (u8g_pb_t *)u8g->getU8g()->dev->dev_mem;
+        const uint8_t *buf = (const uint8_t *)pb->buf;
+        uint8_t page = pb->p.page;
+
+        // Nothing is sent while another user owns the port, see logPause()
+        if (page >= MIRROR_PAGES || logPaused)
+        {
+            return;
+        }
+
+        for (uint8_t s = 0; s < MIRROR_SEGMENTS; s++)
+        {
+            const uint8_t *data = buf + s * MIRROR_SEGMENT;
+            uint8_t id = page * MIRROR_SEGMENTS + s;
+
+            uint16_t sum = fletcher(data, MIRROR_SEGMENT);
+            if (sum == sent[id] && id != refresh)
+            {
+                continue;
+            }
+
+            uint8_t packet[MIRROR_PACKET];
+            uint8_t length = encode(data, MIRROR_SEGMENT, packet + 3);
+
+            if (Serial.availableForWrite() < length + 4)
+            {
+                continue;
+            }
+
+            uint8_t check = id ^ length;
+            for (uint8_t i = 0; i < length; i++)
+            {
+                check ^= packet[3 + i];
+            }
+
+            packet[0] = MIRROR_SYNC;
+            packet[1] = id;
+            packet[2] = length;
+            packet[3 + length] = check;
+            Serial.write(packet, length + 4);
+
+            sent[id] = sum;
+            if (id == refresh)
+            {
+                refresh = (refresh + 1) % (MIRROR_PAGES * MIRROR_SEGMENTS);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * @file Random.h
+ * 
+ * @brief Fast seedable random numbers for the games.
+ * 
+ * One 16 bit seed is collected at boot and everything random follows from
+ * it, so a run can be replayed by defining RANDOM_SEED as the seed that was
+ * logged. The seed comes from the noise in the low bit of the ADC on a
+ * floating pin. The ADC runs free in the background while the rest of the
+ * menu starts, so no analogRead() is left in the games.
+ * 
+ * Each game forks its own xorshift32 stream when it starts, so one game
+ * drawing numbers does not shift the sequence of another.
+*/
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#define ENTROPY_PIN 2
+#define ENTROPY_SAMPLES 64
+
+/**
+ * A xorshift32 random number generator
+ * 
+ * @param state The state, which is never 0
+*/
+class Random
+{
+private:
+    uint32_t state;
+
+public:
+    Random() { seed(1); }
+    Random(uint32_t s) { seed(s); }
+
+    /**
+     * Set the seed. The seed is mixed first, so seeds that are close give
+     * unrelated sequences.
+     * 
+     * @param s The seed
+    */
+    void seed(uint32_t s)
+    {
+        s ^= s >> 16;
+        s *= 0x7FEB352DUL;
+        s ^= s >> 15;
+        s *= 0x846CA68BUL;
+        s ^= s >> 16;
+        state = s ? s : 0x9E3779B9UL;
+    }
+
+    /**
+     * Get the next 32 random bits.
+    */
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /**
+     * Get a number in [0, n) without the bias of next() % n. Uses a 16x16
+     * multiply and only loops in the rare case that the result would be
+     * biased.
+     * 
+     * @param n The number of possible values
+     * @return A number from 0 to n - 1, or 0 if n is 0
+    */
+    uint16_t below(uint16_t n)
+    {
+        if (n == 0)
+        {
+            return 0;
+        }
+
+        uint32_t m = (uint32_t)(uint16_t)(next() >> 16) * n;
+        uint16_t low = m;
+        if (low < n)
+        {
+            uint16_t threshold = (uint16_t)-n % n;
+            while (low < threshold)
+            {
+                m = (uint32_t)(uint16_t)(next() >> 16) * n;
+                low = m;
+            }
+        }
+        return m >> 16;
+    }
+
+    /**
+     * Get a number in [low, high), like random(low, high).
+    */
+    int16_t between(int16_t low, int16_t high)
+    {
+        return low + below(high - low);
+    }
+
+    /**
+     * Start a new stream seeded from this one.
+    */
+    Random fork()
+    {
+        return Random(next());
+    }
+};
+
+Random randomSource;
+uint16_t bootSeed = 0;
+
+volatile uint16_t entropy = 0;
+volatile uint8_t entropySamples = 0;
+
+ISR(ADC_vect)
+{
+    uint8_t low = ADCL;
+    (void)ADCH;
+
+    // Rotate so the noisy low bit lands on every bit of the pool in turn
+    entropy = (entropy << 3 | entropy >> 13) ^ low;
+
+    if (++entropySamples >= ENTROPY_SAMPLES)
+    {
+        ADCSRA &= ~(bit(ADATE) | bit(ADIE));
+    }
+}
+
+/**
+ * Start collecting entropy. The ADC converts the floating pin over and over
+ * and the interrupt folds each result into the pool.
+*/
+void startEntropy()
+{
+    entropySamples = 0;
+    ADMUX = bit(REFS0) | ENTROPY_PIN;
+    ADCSRB = 0;
+    ADCSRA = bit(ADEN) | bit(ADSC) | bit(ADATE) | bit(ADIE) | bit(ADPS2) | bit(ADPS1) | bit(ADPS0);
+}
+
+/**
+ * Seed the random numbers once enough entropy is in. Waits for the last
+ * samples if the rest of the boot was quicker than the ADC. The seed is
+ * kept in bootSeed, to log so the run can be replayed.
+*/
+void seedRandom()
+{
+    while (entropySamples < ENTROPY_SAMPLES)
+    {
+    }
+
+    // Back to the settings analogRead() expects
+    ADCSRA = bit(ADEN) | bit(ADPS2) | bit(ADPS1) | bit(ADPS0);
+
+#ifdef RANDOM_SEED
+    bootSeed = RANDOM_SEED;
+#else
+    bootSeed = entropy ^ micros();
+#endif
+
+    randomSource.seed(bootSeed);
+}
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file Scheduler.h
+ * 
+ * @brief Cooperative scheduler for spreading long work over several frames.
+ * 
+ * Tasks are stackless coroutines in the style of protothreads. A task keeps
+ * its resume point in a member variable, so any state that has to survive a
+ * yield must be stored in members as well, not in locals.
+ * 
+ * Each task gets at most one slice per frame. A slice lasts until the task
+ * yields, and the task's budget decides when TASK_YIELD_IF_OVER_BUDGET()
+ * gives up the slice.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define MAX_TASKS 4
+
+#define TASK_DONE 0
+#define TASK_YIELDED 1
+
+#define FRAME_TASK_BUDGET 2000
+
+/**
+ * Start the body of Task::run().
+*/
+#define TASK_BEGIN() \
+    switch (line)    \
+    {                \
+    case 0:
+
+/**
+ * End this slice and continue from here on the next frame.
+*/
+#define TASK_YIELD()          \
+    do                        \
+    {                         \
+        line = __LINE__;      \
+        return TASK_YIELDED;  \
+    case __LINE__:;           \
+    } while (0)
+
+/**
+ * Yield only if the task has used up its budget for this slice.
+*/
+#define TASK_YIELD_IF_OVER_BUDGET() \
+    do                              \
+    {                               \
+        if (overBudget())           \
+        {                           \
+            TASK_YIELD();           \
+        }                           \
+    } while (0)
+
+/**
+ * End the body of Task::run(). The task is removed from the scheduler.
+*/
+#define TASK_END() \
+    }              \
+    line = 0;      \
+    return TASK_DONE;
+
+/**
+ * Base class for a task that can be run by the scheduler.
+ * 
+ * @param budget Time in microseconds the task may run before it should yield
+*/
+class Task
+{
+protected:
+    unsigned int line = 0;
+    unsigned long started = 0;
+
+    /**
+     * Check if the current slice has run past the budget.
+     * 
+     * @return true if the task should yield
+    */
+    bool overBudget()
+    {
+        return micros() - started >= budget;
+    }
+
+public:
+    unsigned long budget;
+
+    Task(unsigned long _budget = 500)
+    {
+        budget = _budget;
+    }
+
+    /**
+     * Run the task until it yields or finishes.
+     * 
+     * @return TASK_YIELDED or TASK_DONE
+    */
+    virtual char run() = 0;
+
+    /**
+     * Run one slice of the task with a fresh budget.
+     * 
+     * @return TASK_YIELDED or TASK_DONE
+    */
+    char step()
+    {
+        started = micros();
+        return run();
+    }
+
+    /**
+     * Start the task from the beginning the next time it runs.
+    */
+    void restart()
+    {
+        line = 0;
+    }
+};
+
+/**
+ * Round-robin scheduler for tasks.
+*/
+class Scheduler
+{
+private:
+    Task *tasks[MAX_TASKS];
+    int count = 0;
+    int next = 0;
+
+public:
+    /**
+     * Add a task to the scheduler. The task starts from the beginning.
+     * 
+     * @param task The task to add
+     * @return false if the scheduler is full
+    */
+    bool add(Task *task)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (tasks[i] == task)
+            {
+                task->restart();
+                return true;
+            }
+        }
+
+        if (count >= MAX_TASKS)
+        {
+            return false;
+        }
+        task->restart();
+        tasks[count++] = task;
+        return true;
+    }
+
+    /**
+     * Remove a task from the scheduler.
+     * 
+     * @param task The task to remove
+    */
+    void remove(Task *task)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (tasks[i] == task)
+            {
+                // Keep the order, so the round-robin does not skip or repeat
+                // a task
+                count--;
+                for (int j = i; j < count; j++)
+                {
+                    tasks[j] = tasks[j + 1];
+                }
+                if (i < next)
+                {
+                    next--;
+                }
+                return;
+            }
+        }
+    }
+
+    /**
+     * Remove all tasks.
+    */
+    void clear()
+    {
+        count = 0;
+        next = 0;
+    }
+
+    /**
+     * Give each task one slice, round-robin, until every task has had its
+     * slice or the frame budget is spent. The tasks that did not get a slice
+     * go first on the next frame.
+     * 
+     * @param frameBudget Time in microseconds to spend on tasks this frame
+    */
+    void run(unsigned long frameBudget = FRAME_TASK_BUDGET)
+    {
+        unsigned long start = micros();
+        int slices = count;
+
+        while (slices-- > 0 && count > 0 && micros() - start < frameBudget)
+        {
+            if (next >= count)
+            {
+                next = 0;
+            }
+
+            Task *task = tasks[next];
+            if (task->step() == TASK_DONE)
+            {
+                remove(task);
+            }
+            else
+            {
+                next++;
+            }
+        }
+    }
+
+    /**
+     * Check if any task is waiting to run.
+     * 
+     * @return true if there are tasks left
+    */
+    bool busy()
+    {
+        return count > 0;
+    }
+};
+
+Scheduler scheduler;
+
+#endif
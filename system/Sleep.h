@@ -0,0 +1,121 @@
+/**
+ * @file Sleep.h
+ * 
+ * @brief Idle sleep with wake-on-button for the menu system.
+ * 
+ * The buttons on pins 2-6 all sit on PORTD, so one pin change interrupt
+ * (PCINT2) covers them. Power-down stops the timers, so the wake time is
+ * taken in the interrupt and the oscillator start-up is not part of the
+ * measured latency.
+*/
+
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include <avr/sleep.h>
+
+#ifdef LATENCY_TRACE
+#include "Latency.h"
+#endif
+
+#define IDLE_SLEEP_MODE SLEEP_MODE_PWR_DOWN
+#define WAKE_PIN_MASK (bit(PCINT18) | bit(PCINT19) | bit(PCINT20) | bit(PCINT21) | bit(PCINT22))
+
+volatile bool asleep = false;
+volatile bool woken = false;
+volatile unsigned long wakeMicros = 0;
+
+ISR(PCINT2_vect)
+{
+    unsigned long now = micros();
+
+    // With latency tracing the interrupt also sees every edge while awake,
+    // which must not count as a wake
+    if (asleep && !woken)
+    {
+        wakeMicros = now;
+        woken = true;
+    }
+
+#ifdef LATENCY_TRACE
+    latencyTracer.edge(PIND & WAKE_PIN_MASK, now);
+#endif
+}
+
+/**
+ * Select which pins can wake the MCU. The interrupt itself is only enabled
+ * while sleeping, unless latency tracing needs every button edge.
+*/
+void initSleep()
+{
+    PCMSK2 |= WAKE_PIN_MASK;
+
+#ifdef LATENCY_TRACE
+    PCICR |= bit(PCIE2);
+#endif
+}
+
+/**
+ * Put the MCU to sleep until one of the buttons changes state. In idle mode
+ * the timer interrupt also wakes it every millisecond. Returns straight away
+ * if a button is already down.
+ * 
+ * @param mode The AVR sleep mode to use
+*/
+void sleepUntilButton(uint8_t mode = IDLE_SLEEP_MODE)
+{
+    Serial.flush();
+
+    set_sleep_mode(mode);
+
+    cli();
+    woken = false;
+    PCIFR = bit(PCIF2);
+    PCICR |= bit(PCIE2);
+
+    // Clearing the flag forgets any press since the buttons were last read,
+    // for example one that started during Serial.flush(). A button that is
+    // down now would not cause a pin change until it is released, so do
+    // not sleep at all.
+    if (!(PIND & WAKE_PIN_MASK))
+    {
+        asleep = true;
+        sleep_enable();
+
+        // sei() only takes effect after the next instruction, so a pin
+        // change cannot slip in between the check and sleep_cpu().
+        sei();
+        sleep_cpu();
+
+        sleep_disable();
+        asleep = false;
+    }
+    sei();
+
+#ifndef LATENCY_TRACE
+    PCICR &= ~bit(PCIE2);
+#endif
+}
+
+/**
+ * Get the time since the last wake and clear it, so each wake is measured
+ * only once.
+ * 
+ * @return Microseconds since waking, or 0 if there was no new wake
+*/
+unsigned long takeWakeLatency()
+{
+    unsigned long latency = 0;
+
+    cli();
+    if (woken)
+    {
+        latency = micros() - wakeMicros;
+        woken = false;
+    }
+    sei();
+
+    return latency;
+}
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file Ssd1306.h
+ * 
+ * @brief Direct SSD1306 commands for effects u8glib does not cover.
+ * 
+ * Goes through u8glib's own com layer, so it works with whatever bus the
+ * display was set up with. Must not be called inside the picture loop.
+*/
+
+#ifndef SSD1306_H
+#define SSD1306_H
+
+#define SSD1306_SET_START_LINE 0x40
+#define SSD1306_SET_PAGE 0xB0
+#define SSD1306_COLUMN_LOW 0x00
+#define SSD1306_COLUMN_HIGH 0x10
+
+#define SSD1306_RAM_PAGES 8
+#define SSD1306_CHUNK 16
+#define SLIDE_STEP_DELAY 16
+
+/**
+ * Low level access to an SSD1306 display
+ * 
+ * @tparam WIDTH Width of the display in pixels
+ * @tparam HEIGHT Height of the display in pixels
+ * @param u8g U8GLIB object the display was set up with
+*/
+template <int WIDTH, int HEIGHT>
+class Ssd1306
+{
+private:
+    U8GLIB *u8g;
+
+    unsigned long bytesSent = 0;
+
+    void begin()
+    {
+        u8g_SetChipSelect(u8g->getU8g(), u8g->getU8g()->dev, 1);
+    }
+
+    void end()
+    {
+        u8g_SetChipSelect(u8g->getU8g(), u8g->getU8g()->dev, 0);
+    }
+
+    /**
+     * Send a list of command bytes.
+    */
+    void commands(const uint8_t *bytes, uint8_t length)
+    {
+        u8g_t *g = u8g->getU8g();
+        begin();
+        u8g_SetAddress(g, g->dev, 0);
+        u8g_WriteSequence(g, g->dev, length, (uint8_t *)bytes);
+        end();
+        bytesSent += length;
+    }
+
+public:
+    Ssd1306(){};
+    Ssd1306(U8GLIB *_u8g)
+    {
+        u8g = _u8g;
+    }
+
+    /**
+     * Set which row of display RAM is shown at the top of the screen. The
+     * rows above it wrap around to the bottom.
+     * 
+     * @param line The RAM row, 0-63
+    */
+    void setStartLine(uint8_t line)
+    {
+        uint8_t command = SSD1306_SET_START_LINE | (line & 0x3F);
+        commands(&command, 1);
+    }
+
+    /**
+     * Fill part of one RAM page with the same byte. Only the window from the
+     * column on is sent, the rest of the display is left as it is.
+     * 
+     * @param page The RAM page, 0-7
+     * @param column The first column
+     * @param length The number of columns
+     * @param value The byte to write to each column
+    */
+    void fill(uint8_t page, uint8_t column, uint8_t length, uint8_t value)
+    {
+        const uint8_t window[3] = {
+            (uint8_t)(SSD1306_SET_PAGE | page),
+            (uint8_t)(SSD1306_COLUMN_LOW | (column & 0x0F)),
+            (uint8_t)(SSD1306_COLUMN_HIGH | (column >> 4))};
+        commands(window, 3);
+
+        uint8_t chunk[SSD1306_CHUNK];
+        memset(chunk, value, SSD1306_CHUNK);
+
+        u8g_t *g = u8g->getU8g();
+        begin();
+        u8g_SetAddress(g, g->dev, 1);
+        while (length > 0)
+        {
+            uint8_t n = length < SSD1306_CHUNK ? length : SSD1306_CHUNK;
+            u8g_WriteSequence(g, g->dev, n, chunk);
+            length -= n;
+            bytesSent += n;
+        }
+        end();
+    }
+
+    /**
+     * Slide the screen up and out one page at a time by moving the start
+     * line. Each step only blanks the page that is about to come into view,
+     * instead of sending a whole frame.
+     * 
+     * @return The number of bytes sent to the display
+    */
+    unsigned long slideOut()
+    {
+        const uint8_t visible = HEIGHT / 8;
+        unsigned long start = bytesSent;
+
+        for (uint8_t step = 1; step <= SSD1306_RAM_PAGES; step++)
+        {
+            fill((step - 1 + visible) % SSD1306_RAM_PAGES, 0, WIDTH, 0);
+            setStartLine(step * 8);
+
+            if (step <= visible)
+            {
+                delay(SLIDE_STEP_DELAY);
+            }
+        }
+
+        return bytesSent - start;
+    }
+
+    /**
+     * Get the number of command and data bytes sent since boot
+     * 
+     * @return The number of bytes
+    */
+    unsigned long getBytesSent() { return bytesSent; }
+};
+
+#endif
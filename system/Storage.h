@@ -0,0 +1,172 @@
+/**
+ * @file Storage.h
+ * 
+ * @brief Saved high scores and the menu position in EEPROM.
+ * 
+ * The record is written to the next of several slots each time, so the
+ * writes are spread over the EEPROM instead of wearing out one spot. On boot
+ * the valid slot with the newest sequence number wins. Changes are kept in
+ * RAM and only written by commit(), since each EEPROM byte takes about
+ * 3.3 ms to write.
+ * 
+ * Only the GAME_COUNT games of the menu have a high score. The Memory screen
+ * has no score, and a Link Pong score depends on the other board, so
+ * neither is saved.
+*/
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#define STORAGE_VERSION 2
+#define STORAGE_START 0
+#define STORAGE_SLOTS 32
+
+/**
+ * The saved record
+*/
+struct SaveData
+{
+    uint8_t version;
+    uint16_t sequence;
+    uint16_t highScores[GAME_COUNT];
+    uint8_t menuPosition;
+    uint8_t checksum;
+};
+
+/**
+ * Persistent storage for high scores and the menu position.
+*/
+class Storage
+{
+private:
+    SaveData data;
+    int slot = -1;
+    bool dirty = false;
+
+    /**
+     * Calculate the checksum of a record, not counting the checksum itself.
+     * 
+     * @param record The record to check
+     * @return The checksum
+    */
+    uint8_t checksum(const SaveData &record)
+    {
+        const uint8_t *bytes = (const uint8_t *)&record;
+        uint8_t sum = 0xA5;
+        for (unsigned int i = 0; i < sizeof(SaveData) - 1; i++)
+        {
+            sum = (sum << 1 | sum >> 7) ^ bytes[i];
+        }
+        return sum;
+    }
+
+    /**
+     * Get the EEPROM address of a slot.
+    */
+    int address(int index)
+    {
+        return STORAGE_START + index * sizeof(SaveData);
+    }
+
+public:
+    /**
+     * Load the newest valid record, or start from defaults if there is none.
+    */
+    void load()
+    {
+        slot = -1;
+
+        for (int i = 0; i < STORAGE_SLOTS; i++)
+        {
+            SaveData record;
+            EEPROM.get(address(i), record);
+
+            if (record.version != STORAGE_VERSION || record.checksum != checksum(record))
+            {
+                continue;
+            }
+
+            if (slot == -1 || (int16_t)(record.sequence - data.sequence) > 0)
+            {
+                data = record;
+                slot = i;
+            }
+        }
+
+        if (slot == -1)
+        {
+            memset(&data, 0, sizeof(SaveData));
+            data.version = STORAGE_VERSION;
+        }
+        dirty = false;
+    }
+
+    /**
+     * Write the record to the next slot if anything has changed. Should only
+     * be called outside of the frame loop.
+    */
+    void commit()
+    {
+        if (!dirty)
+        {
+            return;
+        }
+
+        slot = (slot + 1) % STORAGE_SLOTS;
+        data.sequence++;
+        data.checksum = checksum(data);
+        EEPROM.put(address(slot), data);
+
+        dirty = false;
+    }
+
+    /**
+     * Record a score, keeping it only if it beats the high score. Scores of
+     * games without a high score, see above, are ignored.
+     * 
+     * @param game The id of the game
+     * @param score The score to record
+    */
+    void submitScore(int game, uint16_t score)
+    {
+        if (game < 0 || game >= GAME_COUNT || score <= data.highScores[game])
+        {
+            return;
+        }
+        data.highScores[game] = score;
+        dirty = true;
+    }
+
+    /**
+     * Get the high score of a game
+     * 
+     * @param game The id of the game
+     * @return The high score
+    */
+    uint16_t getHighScore(int game)
+    {
+        if (game < 0 || game >= GAME_COUNT)
+        {
+            return 0;
+        }
+        return data.highScores[game];
+    }
+
+    /**
+     * Set the last selected menu item
+     * 
+     * @param position The index of the menu item
+    */
+    void setMenuPosition(uint8_t position)
+    {
+        if (data.menuPosition != position)
+        {
+            data.menuPosition = position;
+            dirty = true;
+        }
+    }
+
+    uint8_t getMenuPosition() { return data.menuPosition; }
+};
+
+#endif
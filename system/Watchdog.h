@@ -0,0 +1,245 @@
+/**
+ * @file Watchdog.h
+ * 
+ * @brief Frame deadline watchdog with an overrun log that survives reset.
+ * 
+ * Menu::loop marks each phase of the frame with watchPhase(), which restarts
+ * the watchdog with the deadline of that phase. The watchdog runs in
+ * interrupt-and-reset mode, so an overrun first calls the interrupt. It
+ * writes the phase to a log in .noinit RAM, which the C runtime does not
+ * clear on reset, frees the I2C bus if a device holds SDA low, and then
+ * resets the board. The next boot reports what happened.
+*/
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <avr/wdt.h>
+
+#include "Log.h"
+
+#define OVERRUN_ENTRIES 8
+#define OVERRUN_MAGIC 0x0D06
+
+#define OVERRUN_BUS_STUCK 1
+#define OVERRUN_BUS_FREED 2
+
+#define I2C_RECOVERY_CLOCKS 9
+
+/**
+ * The phases of a frame. The LOG_OVERRUN format in Log.h names them by
+ * number.
+*/
+enum WatchPhase
+{
+    WATCH_NONE,
+    WATCH_DRAW,
+    WATCH_UPDATE,
+    WATCH_MENU,
+    WATCH_LOG,
+    WATCH_PHASE_COUNT
+};
+
+/**
+ * Deadline of each phase. The menu phase covers the slide transition and
+ * the EEPROM commit, so it gets the most time.
+*/
+const uint8_t watchTimeouts[WATCH_PHASE_COUNT] PROGMEM = {
+    WDTO_1S,
+    WDTO_500MS,
+    WDTO_250MS,
+    WDTO_1S,
+    WDTO_250MS};
+
+/**
+ * One overrun
+ * 
+ * @param phase The phase that missed its deadline
+ * @param flags OVERRUN_BUS_STUCK and OVERRUN_BUS_FREED
+ * @param uptime Seconds since boot when it happened
+*/
+struct OverrunEntry
+{
+    uint8_t phase;
+    uint8_t flags;
+    uint16_t uptime;
+};
+
+/**
+ * The overrun log, kept across resets
+*/
+struct OverrunLog
+{
+    uint16_t magic;
+    uint8_t next;
+    uint8_t count;
+    bool pending;
+    OverrunEntry entries[OVERRUN_ENTRIES];
+};
+
+OverrunLog overrunLog __attribute__((section(".noinit")));
+volatile uint8_t watchedPhase = WATCH_NONE;
+
+/**
+ * Turn the watchdog off before anything else runs. After a watchdog reset
+ * it is still running with the shortest timeout, which would reset the
+ * board again before setup().
+ * 
+ * Placed in .init3 like paintStack() in Memory.h.
+*/
+void stopWatchdogAtBoot(void) __attribute__((naked, used, section(".init3")));
+void stopWatchdogAtBoot(void)
+{
+    MCUSR = 0;
+    wdt_disable();
+}
+
+/**
+ * Let an I2C line float high or pull it low, like an open drain output.
+*/
+void i2cLine(uint8_t pin, bool high)
+{
+    if (high)
+    {
+        pinMode(pin, INPUT_PULLUP);
+    }
+    else
+    {
+        digitalWrite(pin, LOW);
+        pinMode(pin, OUTPUT);
+    }
+    delayMicroseconds(5);
+}
+
+/**
+ * Free the I2C bus if a device is holding SDA low, which happens when it
+ * was cut off in the middle of sending a byte. Clocking SCL lets it finish
+ * the byte, and a stop condition then puts it back to idle.
+ * 
+ * @return OVERRUN_BUS_STUCK if SDA was held low, with OVERRUN_BUS_FREED if
+ *         it was let go
+*/
+uint8_t recoverI2C()
+{
+    TWCR = 0;
+    i2cLine(SDA, true);
+    i2cLine(SCL, true);
+
+    if (digitalRead(SDA))
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !digitalRead(SDA); i++)
+    {
+        i2cLine(SCL, false);
+        i2cLine(SCL, true);
+    }
+
+    // Stop condition: SDA goes high while SCL is high
+    i2cLine(SCL, false);
+    i2cLine(SDA, false);
+    i2cLine(SCL, true);
+    i2cLine(SDA, true);
+
+    return digitalRead(SDA) ? OVERRUN_BUS_STUCK | OVERRUN_BUS_FREED : OVERRUN_BUS_STUCK;
+}
+
+/**
+ * Set the watchdog timeout with both the interrupt and the reset enabled.
+ * 
+ * @param timeout One of the WDTO_ values
+*/
+void armWatchdog(uint8_t timeout)
+{
+    uint8_t prescaler = (timeout & 7) | (timeout & 8 ? bit(WDP3) : 0);
+
+    cli();
+    wdt_reset();
+    WDTCSR = bit(WDCE) | bit(WDE);
+    WDTCSR = bit(WDIE) | bit(WDE) | prescaler;
+    sei();
+}
+
+ISR(WDT_vect)
+{
+    OverrunEntry &entry = overrunLog.entries[overrunLog.next];
+    entry.phase = watchedPhase;
+    entry.uptime = millis() / 1000;
+    entry.flags = recoverI2C();
+
+    overrunLog.next = (overrunLog.next + 1) % OVERRUN_ENTRIES;
+    if (overrunLog.count < 0xFF)
+    {
+        overrunLog.count++;
+    }
+    overrunLog.pending = true;
+
+    // Reset now instead of waiting out a second timeout
+    WDTCSR = bit(WDCE) | bit(WDE);
+    WDTCSR = bit(WDE);
+    while (true)
+    {
+    }
+}
+
+/**
+ * Mark the start of a phase and give it a fresh deadline.
+ * 
+ * @param phase The phase that is starting
+*/
+void watchPhase(uint8_t phase)
+{
+    watchedPhase = phase;
+    armWatchdog(pgm_read_byte(&watchTimeouts[phase]));
+}
+
+/**
+ * Stop watching, for sleeping until a button is pressed.
+*/
+void watchStop()
+{
+    watchedPhase = WATCH_NONE;
+    wdt_disable();
+}
+
+/**
+ * Check the overrun log after boot. Logs the overrun that caused the last
+ * reset, if any, and then the whole log, one entry at a time so it never
+ * overfills the log ring. Blocks while the events are sent, so it is only
+ * meant for boot.
+*/
+void reportOverruns()
+{
+    if (overrunLog.magic != OVERRUN_MAGIC || overrunLog.next >= OVERRUN_ENTRIES)
+    {
+        memset(&overrunLog, 0, sizeof(overrunLog));
+        overrunLog.magic = OVERRUN_MAGIC;
+    }
+
+    if (overrunLog.pending)
+    {
+        overrunLog.pending = false;
+
+        LOG_ERROR(LOG_WATCHDOG_RESET, overrunLog.entries[(overrunLog.next + OVERRUN_ENTRIES - 1) % OVERRUN_ENTRIES].phase);
+    }
+
+    LOG_INFO(LOG_OVERRUN_COUNT, overrunLog.count);
+
+    uint8_t shown = min(overrunLog.count, OVERRUN_ENTRIES);
+    for (uint8_t i = 0; i < shown; i++)
+    {
+        const OverrunEntry &entry = overrunLog.entries[(overrunLog.next + OVERRUN_ENTRIES - shown + i) % OVERRUN_ENTRIES];
+
+        logDrain();
+        LOG_WARN(LOG_OVERRUN, entry.phase);
+        LOG_WARN(LOG_OVERRUN_UPTIME, entry.uptime);
+        if (entry.flags & OVERRUN_BUS_STUCK)
+        {
+            LOG_WARN(LOG_I2C_STUCK, entry.flags & OVERRUN_BUS_FREED ? 1 : 0);
+        }
+    }
+    logDrain();
+}
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file Arduino.h
+ * 
+ * @brief The few parts of the Arduino core the link needs, for building it
+ * on a PC. Only enough for linksim.cpp, not a general replacement.
+*/
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PI 3.1415926535897932384626433832795
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_ptr(p) (*(void *const *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#define bit(b) (1UL << (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+#define ISR(vector) void vector(void)
+inline void cli() {}
+inline void sei() {}
+
+extern uint8_t ADCL, ADCH, ADMUX, ADCSRA, ADCSRB;
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS0 6
+
+unsigned long micros();
+unsigned long millis();
+int digitalRead(uint8_t pin);
+
+class Print
+{
+public:
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            write(data[i]);
+        }
+        return length;
+    }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+    virtual ~Print() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+/**
+ * Serial is only used by the log, which the link pauses
+*/
+class HardwareSerial : public Stream
+{
+public:
+    size_t write(uint8_t) { return 1; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int availableForWrite() { return 64; }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * @file U8glib.h
+ * 
+ * @brief A display that draws nothing, for building the link on a PC.
+*/
+
+#ifndef U8GLIB_H
+#define U8GLIB_H
+
+#include "Arduino.h"
+
+typedef uint8_t u8g_uint_t;
+
+struct u8g_box_t
+{
+    u8g_uint_t x0, y0, x1, y1;
+};
+
+struct u8g_t
+{
+    u8g_uint_t width, height;
+    u8g_box_t current_page;
+};
+
+class U8GLIB
+{
+public:
+    u8g_t u;
+    u8g_t *getU8g() { return &u; }
+    void drawBox(u8g_uint_t, u8g_uint_t, u8g_uint_t, u8g_uint_t) {}
+    void drawLine(u8g_uint_t, u8g_uint_t, u8g_uint_t, u8g_uint_t) {}
+    void drawPixel(u8g_uint_t, u8g_uint_t) {}
+    void drawBitmapP(u8g_uint_t, u8g_uint_t, u8g_uint_t, u8g_uint_t, const uint8_t *) {}
+};
+
+#endif
@@ -0,0 +1,388 @@
+/**
+ * @file linksim.cpp
+ *
+ * @brief Runs Link Pong on a PC, to test the link without two boards.
+ *
+ * Build from the top of the repository:
+ *   g++ -std=gnu++11 -O2 -I tools/linksim -o linksim tools/linksim/linksim.cpp
+ *
+ * linksim test
+ *   Runs two boards in one process over a simulated 9600 baud wire with a
+ *   64 byte transmit buffer on each side, and checks the handshake, the
+ *   resends under byte loss and a board leaving the game and coming back.
+ *   Exits with 1 if a check fails.
+ *
+ * linksim PORT [FRAME_MS]
+ *   Runs one board in real time on a serial port, printing the round trip,
+ *   stalls and desyncs every second. Two of them talk over a pseudo-terminal
+ *   pair:
+ *     socat -d -d pty,raw,echo=0 pty,raw,echo=0
+ *     ./linksim /dev/pts/3 & ./linksim /dev/pts/4
+*/
+
+#include <deque>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <time.h>
+
+#include "Arduino.h"
+#include "U8glib.h"
+
+#include "../../system/Log.h"
+#include "../../system/Random.h"
+#include "../../Games/Pong.h"
+#include "../../Games/PongLink.h"
+
+#define BYTE_US 1042
+#define TX_BUFFER 64
+
+uint8_t ADCL, ADCH, ADMUX, ADCSRA, ADCSRB;
+HardwareSerial Serial;
+
+bool realTime = false;
+unsigned long simTime = 0;
+
+unsigned long micros()
+{
+    if (!realTime)
+    {
+        return simTime;
+    }
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000UL + t.tv_nsec / 1000;
+}
+
+unsigned long millis() { return micros() / 1000; }
+
+// The paddle buttons are pressed at random
+int digitalRead(uint8_t pin) { return (pin == 2 || pin == 3) && rand() % 4 == 0; }
+
+/**
+ * One direction of a serial wire. Each byte is stamped with the time it has
+ * been sent, one byte time after the one before it.
+*/
+struct Wire
+{
+    std::deque<std::pair<unsigned long, uint8_t>> bytes;
+    unsigned long last = 0;
+    int loss = 0;
+};
+
+/**
+ * A port on the simulated wire. Bytes still waiting to be sent count
+ * against the transmit buffer, and a write into a full buffer is counted
+ * as one that would have blocked the board.
+*/
+class SimPort : public Stream
+{
+public:
+    Wire *tx;
+    Wire *rx;
+    unsigned long sent = 0;
+    unsigned long blocked = 0;
+
+    int queued()
+    {
+        int n = 0;
+        for (size_t i = tx->bytes.size(); i > 0 && tx->bytes[i - 1].first > simTime; i--)
+        {
+            n++;
+        }
+        return n;
+    }
+
+    size_t write(uint8_t c)
+    {
+        if (queued() >= TX_BUFFER)
+        {
+            blocked++;
+        }
+        tx->last = max(tx->last, simTime) + BYTE_US;
+        sent++;
+        if (tx->loss == 0 || rand() % tx->loss != 0)
+        {
+            tx->bytes.push_back(std::make_pair(tx->last, c));
+        }
+        return 1;
+    }
+
+    int availableForWrite() { return TX_BUFFER - queued(); }
+
+    int available()
+    {
+        int n = 0;
+        for (size_t i = 0; i < rx->bytes.size() && rx->bytes[i].first <= simTime; i++)
+        {
+            n++;
+        }
+        return n;
+    }
+
+    int read()
+    {
+        uint8_t c = rx->bytes.front().second;
+        rx->bytes.pop_front();
+        return c;
+    }
+
+    using Print::write;
+};
+
+/**
+ * A port on a serial device or pseudo-terminal
+*/
+class TtyPort : public Stream
+{
+public:
+    int fd;
+
+    size_t write(uint8_t c)
+    {
+        while (::write(fd, &c, 1) != 1)
+        {
+            usleep(100);
+        }
+        return 1;
+    }
+
+    int availableForWrite()
+    {
+        int n = 0;
+        ioctl(fd, TIOCOUTQ, &n);
+        return max(TX_BUFFER - n, 0);
+    }
+
+    int available()
+    {
+        int n = 0;
+        ioctl(fd, FIONREAD, &n);
+        return n;
+    }
+
+    int read()
+    {
+        uint8_t c;
+        return ::read(fd, &c, 1) == 1 ? c : -1;
+    }
+
+    using Print::write;
+};
+
+U8GLIB display;
+
+/**
+ * One simulated board
+*/
+struct Board
+{
+    Pong<128, 64> pong;
+    PongLink<128, 64> link;
+    SimPort port;
+
+    Board() : pong(&display) {}
+
+    void begin() { link.begin(&pong, &port, &display); }
+};
+
+/**
+ * Two boards joined by a simulated wire
+*/
+struct Pair
+{
+    Wire ab;
+    Wire ba;
+    Board a;
+    Board b;
+
+    Pair(int loss)
+    {
+        ab.loss = loss;
+        ba.loss = loss;
+        a.port.tx = &ab;
+        a.port.rx = &ba;
+        b.port.tx = &ba;
+        b.port.rx = &ab;
+    }
+
+    /**
+     * Run both boards, half a frame apart.
+    */
+    void run(int frames, unsigned long frameUs, bool withB = true)
+    {
+        for (int f = 0; f < frames; f++)
+        {
+            simTime += frameUs / 2;
+            a.link.update();
+            simTime += frameUs / 2;
+            if (withB)
+            {
+                b.link.update();
+            }
+        }
+    }
+};
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+    printf("  %s: %s\n", ok ? "ok" : "FAIL", what);
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+/**
+ * One board waits 30 frames before the other joins. Every hello queued in
+ * that time must not start a stream of answers.
+*/
+void testLateJoin()
+{
+    printf("late join\n");
+    Pair p(0);
+    randomSource.seed(1);
+    p.a.begin();
+    p.run(30, 100000, false);
+    randomSource.seed(2);
+    p.b.begin();
+    p.run(1000, 100000);
+
+    unsigned long sentA = p.a.port.sent;
+    unsigned long sentB = p.b.port.sent;
+    unsigned int stalls = p.a.link.getStalls();
+    p.run(1000, 100000);
+
+    printf("  bytes per frame %.1f / %.1f\n", (p.a.port.sent - sentA) / 1000.0, (p.b.port.sent - sentB) / 1000.0);
+    check(p.a.port.sent - sentA <= 1000 * LINK_PACKET && p.b.port.sent - sentB <= 1000 * LINK_PACKET, "one packet per frame once running");
+    check(p.a.link.getStalls() == stalls, "no stalls once running");
+    check(p.a.port.blocked == 0 && p.b.port.blocked == 0, "no write into a full transmit buffer");
+    check(p.a.link.getDesyncs() == 0 && p.b.link.getDesyncs() == 0, "no desyncs");
+}
+
+/**
+ * Both boards lose 0.5% of the bytes they send.
+*/
+void testLoss(unsigned long frameUs, double maxStalls)
+{
+    printf("0.5%% byte loss, %lu ms frames\n", frameUs / 1000);
+    Pair p(200);
+    randomSource.seed(3);
+    p.a.begin();
+    randomSource.seed(4);
+    p.b.begin();
+
+    const int frames = 20000;
+    p.run(frames, frameUs);
+
+    double stalls = (double)p.a.link.getStalls() / frames;
+    printf("  stalled frames %.1f%%, round trip %lu ms\n", stalls * 100, p.a.link.getRoundTrip() / 1000);
+    check(stalls < maxStalls, "stalls stay low");
+    check(p.a.port.blocked == 0 && p.b.port.blocked == 0, "no write into a full transmit buffer");
+    check(p.a.link.getDesyncs() == 0 && p.b.link.getDesyncs() == 0, "no desyncs");
+}
+
+/**
+ * One board leaves the game while the other keeps running, and comes back
+ * with a new seed.
+*/
+void testRejoin()
+{
+    printf("rejoin\n");
+    Pair p(0);
+    randomSource.seed(5);
+    p.a.begin();
+    randomSource.seed(6);
+    p.b.begin();
+    p.run(500, 100000);
+
+    p.b.link.end();
+    p.run(20, 100000, false);
+    p.b.begin();
+    p.run(100, 100000);
+
+    unsigned int stallsA = p.a.link.getStalls();
+    unsigned int stallsB = p.b.link.getStalls();
+    p.run(500, 100000);
+
+    check(p.a.link.getStalls() == stallsA && p.b.link.getStalls() == stallsB, "both boards run again");
+    check(p.a.link.getDesyncs() == 0 && p.b.link.getDesyncs() == 0, "no desyncs");
+}
+
+int runTests()
+{
+    testLateJoin();
+    testLoss(20000, 0.15);
+    testLoss(100000, 0.02);
+    testRejoin();
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
+
+int runPort(const char *path, unsigned long frameUs)
+{
+    TtyPort port;
+    port.fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port.fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    termios tty;
+    if (tcgetattr(port.fd, &tty) == 0)
+    {
+        cfmakeraw(&tty);
+        cfsetspeed(&tty, B9600);
+        tcsetattr(port.fd, TCSANOW, &tty);
+    }
+
+    realTime = true;
+    srand(getpid());
+    randomSource.seed(micros() ^ getpid());
+
+    Board board;
+    board.link.begin(&board.pong, &port, &display);
+
+    unsigned long next = micros();
+    unsigned long report = next;
+    while (true)
+    {
+        board.link.update();
+
+        next += frameUs;
+        long wait = next - micros();
+        if (wait > 0)
+        {
+            usleep(wait);
+        }
+
+        if (micros() - report >= 1000000)
+        {
+            report += 1000000;
+            printf("rtt %lu ms, stalls %u, desyncs %u\n", board.link.getRoundTrip() / 1000, board.link.getStalls(), board.link.getDesyncs());
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: linksim test | linksim PORT [FRAME_MS]\n");
+        return 2;
+    }
+
+    if (strcmp(argv[1], "test") == 0)
+    {
+        return runTests();
+    }
+
+    return runPort(argv[1], (argc > 2 ? atoi(argv[2]) : 100) * 1000UL);
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Decode the log the sketch sends over Serial, see system/Log.h.
+
+Reads a capture file, or standard input when no file is given. To read a
+board directly, set the port up first:
+
+    stty -F /dev/ttyACM0 9600 raw
+    python3 tools/logdecode.py /dev/ttyACM0
+
+Events are printed with the format strings the board sends at boot. Events
+that arrive before the formats are printed with their raw ID and argument.
+Screen mirror frames are skipped, see tools/mirror.py.
+"""
+
+import sys
+
+SYNC = 0xA5
+FRAME_EVENT = 0x80
+FRAME_FORMAT = 0x81
+FRAME_TEXT = 0x82
+
+
+def frames(stream):
+    """
+    Yield (type, payload) for each frame with a good checksum. After a bad
+    frame the search for the next sync byte starts one byte after the last
+    one, so a frame cut short by a reset is skipped without losing the next.
+    """
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buffer += chunk
+
+        while buffer:
+            start = buffer.find(SYNC)
+            if start < 0:
+                buffer.clear()
+                break
+            del buffer[:start]
+
+            if len(buffer) < 3 or len(buffer) < buffer[2] + 4:
+                break
+
+            kind, length = buffer[1], buffer[2]
+            payload = bytes(buffer[3:3 + length])
+            check = kind ^ length
+            for b in payload:
+                check ^= b
+
+            if check != buffer[3 + length]:
+                del buffer[:1]
+                continue
+
+            del buffer[:length + 4]
+            yield kind, payload
+
+
+def render(format, arg):
+    """Fill in the argument like the %u and %d of printf."""
+    if "%d" in format and arg >= 0x8000:
+        arg -= 0x10000
+    if "%" in format:
+        return format % arg
+    return format
+
+
+def main():
+    stream = open(sys.argv[1], "rb", buffering=0) if len(sys.argv) > 1 else sys.stdin.buffer
+    formats = {}
+    text = ""
+
+    for kind, payload in frames(stream):
+        if kind == FRAME_EVENT and len(payload) == 3:
+            id, arg = payload[0], payload[1] | payload[2] << 8
+            if id in formats:
+                print(render(formats[id], arg))
+            else:
+                print("event %d: %d" % (id, arg))
+        elif kind == FRAME_FORMAT and payload:
+            formats[payload[0]] = payload[1:].decode("ascii", "replace")
+        elif kind == FRAME_TEXT:
+            text += payload.decode("ascii", "replace")
+            while "\n" in text:
+                line, text = text.split("\n", 1)
+                print(line.rstrip("\r"))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
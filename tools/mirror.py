@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+Turn the screen mirror stream into PBM images, see system/Mirror.h.
+
+    python3 tools/mirror.py capture.bin frames/
+
+Reads a capture file, or a port set up with stty as for logdecode.py, and
+writes frames/0000.pbm, frames/0001.pbm and so on. The board sends the
+pages of a frame in order, so a segment with a lower id than the one before
+starts a new frame. Log frames in the stream are skipped.
+"""
+
+import os
+import sys
+
+from logdecode import frames
+
+WIDTH = 128
+HEIGHT = 64
+SEGMENT = 32
+SEGMENTS = WIDTH // SEGMENT
+PAGES = HEIGHT // 8
+
+
+def unpack(data):
+    """Undo the PackBits style RLE of a segment."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        control = data[i]
+        if control < 0x80:
+            out += bytes([data[i + 1]]) * (control + 1)
+            i += 2
+        else:
+            count = control - 0x7F
+            out += data[i + 1:i + 1 + count]
+            i += 1 + count
+    return out
+
+
+def pbm(screen):
+    """Build a binary PBM from the SSD1306 layout of column bytes per page."""
+    rows = bytearray()
+    for y in range(HEIGHT):
+        page, bit = divmod(y, 8)
+        for x in range(0, WIDTH, 8):
+            byte = 0
+            for i in range(8):
+                if screen[page * WIDTH + x + i] >> bit & 1:
+                    byte |= 0x80 >> i
+            rows.append(byte)
+    return b"P4\n%d %d\n" % (WIDTH, HEIGHT) + bytes(rows)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip())
+        return
+
+    stream = open(sys.argv[1], "rb", buffering=0)
+    directory = sys.argv[2] if len(sys.argv) > 2 else "frames"
+    os.makedirs(directory, exist_ok=True)
+
+    screen = bytearray(WIDTH * PAGES)
+    count = 0
+    last = -1
+    changed = False
+
+    def save():
+        nonlocal count
+        with open(os.path.join(directory, "%04d.pbm" % count), "wb") as f:
+            f.write(pbm(screen))
+        count += 1
+
+    for kind, payload in frames(stream):
+        if kind >= SEGMENTS * PAGES:
+            continue
+
+        if kind <= last and changed:
+            save()
+            changed = False
+        last = kind
+
+        data = unpack(payload)
+        if len(data) != SEGMENT:
+            continue
+        page, segment = divmod(kind, SEGMENTS)
+        start = page * WIDTH + segment * SEGMENT
+        screen[start:start + SEGMENT] = data
+        changed = True
+
+    if changed:
+        save()
+    print("%d frames written to %s" % (count, directory))
+
+
+if __name__ == "__main__":
+    main()